@@ -11,6 +11,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -32,6 +33,9 @@ namespace leveldb {
             if(!s.ok()) {
                 return s;
             }
+            if(options.rate_limiter != nullptr) {
+                file = NewRateLimitedWritableFile(file, options.rate_limiter, RateLimiter::kFlush);
+            }
             // 创建一个TableBuilder对象用于创建sstable文件
             TableBuilder* builder = new TableBuilder(options, file);
             // 保存sstable文件的最小key
@@ -34,6 +34,7 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -42,12 +43,21 @@ namespace leveldb {
     // 保存等待writer时的信息
     struct DBImpl::Writer {
         explicit Writer(port::Mutex* mu)
-            : batch(nullptr), sync(false), done(false), cv(mu) {}
+            : batch(nullptr), sync(false), done(false), last_sequence(0),
+              insert_mem(nullptr), leader(nullptr), pending_inserts(0), cv(mu) {}
 
         Status status;
         WriteBatch* batch;
         bool sync;
         bool done;
+        // 流水线写入时，当前writer作为leader所领导的组分配到的最后一个sequence
+        SequenceNumber last_sequence;
+        // 并发写memtable时，leader指定本writer需要自行插入batch的memtable，为nullptr表示无需插入
+        MemTable* insert_mem;
+        // 并发写memtable时本writer所在组的leader
+        Writer* leader;
+        // 并发写memtable时，leader所在组中尚未完成插入的其他writer数量
+        int pending_inserts;
         port::CondVar cv;
     };
 
@@ -83,6 +93,67 @@ namespace leveldb {
         uint64_t total_bytes;
     };
 
+    // 一个子compaction，负责合并compaction中user key位于[begin, end)的数据
+    struct DBImpl::Subcompaction {
+        Subcompaction(DBImpl* db, Compaction* c, port::CondVar* done_signal)
+            : db(db), compact(new CompactionState(c)), input(nullptr),
+              has_begin(false), has_end(false), done(false), done_signal(done_signal) {}
+
+        DBImpl* const db;
+        CompactionState* const compact;
+        Iterator* input;
+        std::string begin;
+        bool has_begin;
+        std::string end;
+        bool has_end;
+        Status status;
+        // 执行完毕时在持有锁的情况下置为true，并通过done_signal通知等待的线程
+        bool done;
+        port::CondVar* const done_signal;
+    };
+
+    // 读操作需要的mem、imm以及current version的集合，整体引用计数。
+    // 每个线程缓存一个SuperVersion，只要没有新的SuperVersion被安装，读操作就不需要获取mutex_
+    struct DBImpl::SuperVersion {
+        MemTable* mem;
+        // 按照从新到旧的顺序排列
+        std::vector<MemTable*> imms;
+        Version* current;
+        uint64_t version_number;
+        std::atomic<int> refs;
+
+        SuperVersion* Ref() {
+            refs.fetch_add(1, std::memory_order_relaxed);
+            return this;
+        }
+
+        // 返回true表示这是最后一个引用，调用者需要在持有mutex_时调用CleanupSuperVersion()并释放它
+        bool Unref() {
+            return refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+    };
+
+    // 线程局部槽位中的特殊值：kSVInUse表示本线程正在使用缓存的SuperVersion，
+    // kSVObsolete表示缓存已经被InstallSuperVersion()清除
+    static int dummy_sv_in_use;
+    static void* const kSVInUse = &dummy_sv_in_use;
+    static void* const kSVObsolete = nullptr;
+
+    // 线程退出时释放其缓存的SuperVersion。被缓存的SuperVersion一定是当前的super_version_
+    // （旧的会在安装新的SuperVersion时被清除），DBImpl持有其引用，所以这里不会是最后一个引用
+    void DBImpl::SuperVersionUnrefHandle(void* ptr) {
+        SuperVersion* sv = static_cast<SuperVersion*>(ptr);
+        bool was_last_ref = sv->Unref();
+        (void)was_last_ref;
+        assert(!was_last_ref);
+    }
+
+    // 写入被限速时每次睡眠的最长时间，睡醒后重新检查是否仍需要限速
+    static const uint64_t kDelayIntervalMicros = 1000;
+
+    // compaction读取输入时每读出这么多字节向rate_limiter申请一次额度
+    static const int64_t kCompactionReadChargeBytes = 64 << 10;
+
     template <class T, class V>
     static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
         if(static_cast<V>(*ptr) > maxvalue) {
@@ -96,14 +167,39 @@ namespace leveldb {
     Options SanitizeOptions(const std::string& dbname,
                             const InternalKeyComparator* icmp,
                             const InternalFilterPolicy* ipolicy,
+                            const InternalSliceTransform* iprefix,
                             const Options& src) {
         Options result = src;
         result.comparator = icmp;
         result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
+        result.prefix_extractor = (src.prefix_extractor != nullptr) ? iprefix : nullptr;
         ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
         ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+        ClipToRange(&result.max_write_buffer_number, 2, 64);
+        ClipToRange(&result.max_background_compactions, 1, 64);
+        ClipToRange(&result.max_subcompactions, 1, 64);
         ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
         ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+        ClipToRange(&result.index_partition_size, 1 << 10, 4 << 20);
+        ClipToRange(&result.level0_slowdown_writes_trigger, config::kL0_CompactionTrigger, 1 << 30);
+        if(result.level0_stop_writes_trigger < result.level0_slowdown_writes_trigger) {
+            result.level0_stop_writes_trigger = result.level0_slowdown_writes_trigger;
+        }
+        if(result.hard_pending_compaction_bytes_limit > 0 &&
+           result.hard_pending_compaction_bytes_limit < result.soft_pending_compaction_bytes_limit) {
+            result.hard_pending_compaction_bytes_limit = result.soft_pending_compaction_bytes_limit;
+        }
+        if(result.delayed_write_rate == 0) {
+            result.delayed_write_rate = 16 * 1024 * 1024;
+        }
+        if(!(result.data_block_hash_table_util_ratio > 0)) {
+            result.data_block_hash_table_util_ratio = 0.75;
+        }
+        if(!(result.memtable_bloom_size_ratio > 0)) {
+            result.memtable_bloom_size_ratio = 0;
+        } else if(result.memtable_bloom_size_ratio > 0.25) {
+            result.memtable_bloom_size_ratio = 0.25;
+        }
 
         if(result.info_log == nullptr) {
             // 在与db相同的目录中打开一个日志文件
@@ -133,8 +229,9 @@ namespace leveldb {
         : env_(raw_options.env),
           internal_comparator_(raw_options.comparator),
           internal_filter_policy_(raw_options.filter_policy),
+          internal_prefix_extractor_(raw_options.prefix_extractor),
           options_(SanitizeOptions(dbname, &internal_comparator_,
-                                   &internal_filter_policy_, raw_options)),
+                                   &internal_filter_policy_, &internal_prefix_extractor_, raw_options)),
           owns_info_log_(options_.info_log != raw_options.info_log),
           owns_cache_(options_.block_cache != raw_options.block_cache),
           dbname_(dbname),
@@ -143,14 +240,20 @@ namespace leveldb {
           shutting_down_(false),
           background_work_finished_signal_(&mutex_),
           mem_(nullptr),
-          imm_(nullptr),
-          has_imm_(false),
           logfile_(nullptr),
           logfile_number_(0),
           log_(nullptr),
           seed_(0),
+          super_version_(nullptr),
+          super_version_number_(0),
+          local_sv_(&SuperVersionUnrefHandle),
           tmp_batch_(new WriteBatch),
-          background_compaction_scheduled_(false),
+          write_controller_(options_),
+          last_batch_group_size_(0),
+          stall_micros_(0),
+          memtable_writers_drained_signal_(&mutex_),
+          background_compactions_scheduled_(0),
+          background_flush_scheduled_(false),
           manual_compaction_(nullptr),
           versions_(new VersionSet(dbname_, &options_, table_cache_,
                                    &internal_comparator_)) {}
@@ -159,9 +262,22 @@ namespace leveldb {
         // 等待后台工作完成
         mutex_.Lock();
         shutting_down_.store(true, std::memory_order_release);
-        while(background_compaction_scheduled_) {
+        while(background_compactions_scheduled_ > 0 || background_flush_scheduled_) {
             background_work_finished_signal_.Wait();
         }
+        // 释放各线程缓存的以及当前的SuperVersion
+        std::vector<void*> cached_svs;
+        local_sv_.Scrape(&cached_svs, kSVObsolete);
+        for(void* ptr : cached_svs) {
+            SuperVersion* sv = static_cast<SuperVersion*>(ptr);
+            if(ptr != kSVInUse && sv->Unref()) {
+                CleanupSuperVersion(sv);
+            }
+        }
+        if(super_version_ != nullptr && super_version_->Unref()) {
+            CleanupSuperVersion(super_version_);
+        }
+        super_version_ = nullptr;
         mutex_.Unlock();
         if(db_lock_ != nullptr) {
             env_->UnlockFile(db_lock_);
@@ -171,8 +287,8 @@ namespace leveldb {
         if(mem_ != nullptr) {
             mem_->Unref();
         }
-        if(imm_ != nullptr) {
-            imm_->Unref();
+        for(MemTable* imm : imm_) {
+            imm->Unref();
         }
 
         delete tmp_batch_;
@@ -229,6 +345,12 @@ namespace leveldb {
         return s;
     }
 
+    MemTable* DBImpl::NewMemTable() const {
+        const uint32_t bloom_bits = static_cast<uint32_t>(
+                options_.write_buffer_size * options_.memtable_bloom_size_ratio * 8);
+        return new MemTable(internal_comparator_, bloom_bits);
+    }
+
     void DBImpl::MaybeIgnoreError(Status *s) const {
         if(s->ok() || options_.paranoid_checks) {
             // no change needed
@@ -278,6 +400,7 @@ namespace leveldb {
                     case kCurrentFile:
                     case kDBLockFile:
                     case kInfoLogFile:
+                    case kIdentityFile:
                         keep = true;
                         break;
                 }
@@ -339,6 +462,17 @@ namespace leveldb {
             }
         }
 
+        // persistent_cache中的key以数据库的唯一标识区分不同的数据库，
+        // 需要在恢复log（可能生成并读取SSTable）之前设置
+        if(options_.persistent_cache != nullptr) {
+            std::string identity;
+            s = GetOrCreateDBIdentity(env_, dbname_, &identity);
+            if(!s.ok()) {
+                return s;
+            }
+            table_cache_->SetPersistentCacheId(identity);
+        }
+
         // 根据MANIFEST文件执行Recover
         s = versions_->Recover(save_manifest);
         if(!s.ok()) {
@@ -453,7 +587,7 @@ namespace leveldb {
 
             WriteBatchInternal::SetContents(&batch, record);
             if(mem == nullptr) {
-                mem = new MemTable(internal_comparator_);
+                mem = NewMemTable();
                 mem->Ref();
             }
             // 将WriteBatch batch的数据插入到MemTable mem中
@@ -475,7 +609,7 @@ namespace leveldb {
                 compactions++;
                 *save_manifest = true;
                 // 将memtable写到level-0
-                status = WriteLevel0Table(mem, edit, nullptr);
+                status = WriteLevel0Table(mem, edit, nullptr, nullptr);
                 mem->Unref();
                 mem = nullptr;
                 if(!status.ok()) {
@@ -503,7 +637,7 @@ namespace leveldb {
                     mem_ = mem;
                     mem = nullptr;
                 } else {
-                    mem_ = new MemTable(internal_comparator_);
+                    mem_ = NewMemTable();
                     mem_->Ref();
                 }
             }
@@ -513,7 +647,7 @@ namespace leveldb {
             // mem没有被重用，将其compact
             if(status.ok()) {
                 *save_manifest = true;
-                status = WriteLevel0Table(mem, edit, nullptr);
+                status = WriteLevel0Table(mem, edit, nullptr, nullptr);
             }
             mem->Unref();
         }
@@ -522,7 +656,8 @@ namespace leveldb {
     }
 
     // 将内存memtable数据写到磁盘sstable文件中
-    Status DBImpl::WriteLevel0Table(MemTable *mem, VersionEdit *edit, Version *base) {
+    Status DBImpl::WriteLevel0Table(MemTable *mem, VersionEdit *edit, Version *base,
+                                    uint64_t *pending_number) {
         mutex_.AssertHeld();
         const uint64_t start_micros = env_->NowMicros();
         // 创建sstable文件的元数据信息
@@ -547,7 +682,11 @@ namespace leveldb {
             s.ToString().c_str());
 
         delete iter;
-        pending_outputs_.erase(meta.number);
+        if(pending_number != nullptr) {
+            *pending_number = meta.number;
+        } else {
+            pending_outputs_.erase(meta.number);
+        }
 
         // 如果file_size为0，则表示文件已被删除，此时不应该将其加入到VersionEdit中
         int level = 0;
@@ -569,16 +708,20 @@ namespace leveldb {
         return s;
     }
 
+    // 每次将最旧的一个immutable memtable写入sstable
     void DBImpl::CompactMemTable() {
         mutex_.AssertHeld();
-        assert(imm_ != nullptr);
+        assert(!imm_.empty());
 
         // 将immutable memtable写入sstable，并记录在edit中，
+        // 写入期间会释放锁，新的immutable memtable只会被加入队尾，所以imm一直是队首
+        MemTable* imm = imm_.front();
         VersionEdit edit;
-        Version* base = versions_->current();
-        base->Ref();
-        Status s = WriteLevel0Table(imm_, &edit, base);
-        base->Unref();
+        // memtable落盘与compaction并发进行：在BuildTable()与LogAndApply()释放锁期间，
+        // 其他compaction可能被选中并向更高的level写入与imm重叠的输出文件，
+        // 此前选择的level因此会失效，所以imm总是写入level 0
+        uint64_t file_number;
+        Status s = WriteLevel0Table(imm, &edit, nullptr, &file_number);
 
         if(s.ok() && shutting_down_.load(std::memory_order_acquire)) {
             s = Status::IOError("Deleting DB during memtable compaction");
@@ -586,15 +729,18 @@ namespace leveldb {
 
         if(s.ok()) {
             edit.SetPrevLogNumber(0);
-            edit.SetLogNumber(logfile_number_);
+            // 比imm更新的memtable的数据所在的log文件仍然需要保留
+            edit.SetLogNumber(imm->GetNextLogNumber());
             // 将edit应用到当前Version
             s = versions_->LogAndApply(&edit, &mutex_);
         }
+        pending_outputs_.erase(file_number);
 
         if(s.ok()) {
-            imm_->Unref();
-            imm_ = nullptr;
-            has_imm_.store(false, std::memory_order_release);
+            assert(imm == imm_.front());
+            imm_.pop_front();
+            imm->Unref();
+            InstallSuperVersion();
             // 清理垃圾文件
             RemoveObsoleteFiles();
         } else {
@@ -660,10 +806,10 @@ namespace leveldb {
         Status s = Write(WriteOptions(), nullptr);
         if(s.ok()) {
             MutexLock l(&mutex_);
-            while(imm_ != nullptr && bg_error_.ok()) {
+            while(!imm_.empty() && bg_error_.ok()) {
                 background_work_finished_signal_.Wait();
             }
-            if(imm_ != nullptr) {
+            if(!imm_.empty()) {
                 s = bg_error_;
             }
         }
@@ -678,79 +824,109 @@ namespace leveldb {
         }
     }
 
-    // 用于检查是否需要执行Compaction操作
+    // 用于检查是否需要执行memtable落盘或Compaction操作，两者分别被调度到Env的HIGH和LOW线程池中
     void DBImpl::MaybeScheduleCompaction() {
         // 此方法是一个递归调用
 
         mutex_.AssertHeld();
-        if(background_compaction_scheduled_) {
-            // already schedule
-            // 工作队列中已经有一个compaction操作在准备执行或已经在执行
-        } else if(!bg_error_.ok()) {
+        if(shutting_down_.load(std::memory_order_acquire)) {
             // DB is being deleted; no more background compactions;
+            return;
         } else if(!bg_error_.ok()) {
             // already got an error; no more changes
-        } else if(imm_ == nullptr && manual_compaction_ == nullptr &&
-                  !versions_->NeedsCompaction()) {
+            return;
+        }
+
+        // 1. memtable落盘，落盘需按immutable memtable的生成顺序进行，所以同一时刻只调度一个
+        if(!background_flush_scheduled_ && !imm_.empty()) {
+            background_flush_scheduled_ = true;
+            env_->Schedule(&DBImpl::BGFlushWork, this, Env::HIGH);
+        }
+
+        // 2. compaction
+        if(background_compactions_scheduled_ >= options_.max_background_compactions) {
+            // already schedule
+            // 工作队列中的compaction操作数量已达上限
+        } else if(manual_compaction_ != nullptr && background_compactions_scheduled_ > 0) {
+            // 手动compaction需要独占执行，等已调度的compaction完成后再调度
+        } else if(manual_compaction_ == nullptr && !versions_->NeedsCompaction()) {
             // No work to be done 这是递归调用的结束点，结束条件为：
-            // 1. 当前immutable memtable 为 null，没有senior compaction;
-            // 2. 没有手动compaction;
-            // 3. VersionSet判定为不需要执行compaction，没有size compaction和seek compaction;
+            // 1. 没有手动compaction;
+            // 2. VersionSet判定为不需要执行compaction，没有size compaction和seek compaction;
             // 也即没有需要执行的compaction操作
         } else {
-            // 工作队列中的compaction操作以及执行完毕，可以放入一个
+            // 工作队列中的compaction操作数量未达上限，可以放入一个
             // 新的compaction。
-
-            // 用于标记工作队列中是否已经有一个compaction操作
-            background_compaction_scheduled_ = true;
+            background_compactions_scheduled_++;
             // 将BGWork放入线程池的工作队列，由子线程来完成，这会进入一个递归调用
-            env_->Schedule(&DBImpl::BGWork, this);
+            env_->Schedule(&DBImpl::BGWork, this, Env::LOW);
             // 这是递归调用的入口，调用链如下：
             // BGWork()->BackgroundCall()->MaybeScheduleCompaction()
         }
     }
 
+    void DBImpl::BGFlushWork(void *db) {
+        reinterpret_cast<DBImpl*>(db)->BackgroundFlushCall();
+    }
+
+    void DBImpl::BackgroundFlushCall() {
+        MutexLock l(&mutex_);
+        assert(background_flush_scheduled_);
+        if(shutting_down_.load(std::memory_order_acquire)) {
+            // no more background work when shutting down
+        } else if(!bg_error_.ok()) {
+            // No more background work after a background error.
+        } else if(!imm_.empty()) {
+            // 将最旧的immutable memtable落盘
+            CompactMemTable();
+        }
+        background_flush_scheduled_ = false;
+        // 还有immutable memtable则继续调度落盘，新生成的level 0文件也可能触发compaction
+        MaybeScheduleCompaction();
+        background_work_finished_signal_.SignalAll();
+    }
+
     void DBImpl::BGWork(void *db) {
         reinterpret_cast<DBImpl*>(db)->BackgroundCall();
     }
 
     void DBImpl::BackgroundCall() {
         MutexLock l(&mutex_);
-        assert(background_compaction_scheduled_);
+        assert(background_compactions_scheduled_ > 0);
+        bool did_work = false;
         if(shutting_down_.load(std::memory_order_acquire)) {
             // no more background work when shutting down
         } else if(!bg_error_.ok()) {
             // No more background work after a background error.
         } else {
             // 执行后台compaction操作
-            BackgroundCompaction();
+            did_work = BackgroundCompaction();
         }
         // 标记当前compaction操作已经执行完成
-        background_compaction_scheduled_ = false;
-        // 执行完成compaction后重新进入递归入口，检查是否还有compaction操作需要执行
-        MaybeScheduleCompaction();
+        background_compactions_scheduled_--;
+        // 执行完成compaction后重新进入递归入口，检查是否还有compaction操作需要执行。
+        // 若本次因与正在执行的compaction冲突而没有可做的工作，则由它们完成时再调度，避免空转
+        if(did_work || background_compactions_scheduled_ == 0) {
+            MaybeScheduleCompaction();
+        }
         background_work_finished_signal_.SignalAll();
     }
 
     // 执行compaction操作
-    void DBImpl::BackgroundCompaction() {
+    bool DBImpl::BackgroundCompaction() {
         mutex_.AssertHeld();
         /**
-         * @brief compaction的优先级：
-         *  1. 先检查是否需要执行minor compaction，如果需要则执行；
-         *  2. 检查是否有手动指定的compaction操作，如果有则执行；
-         *  3. 检查是否有size compaction和seek compaction，size compaction的优先级更高；
+         * @brief compaction的优先级（minor compaction由BackgroundFlushCall单独执行）：
+         *  1. 检查是否有手动指定的compaction操作，如果有则执行；
+         *  2. 检查是否有size compaction和seek compaction，size compaction的优先级更高；
          */
 
-
-        // minor compaction的触发条件
-        if(imm_ != nullptr) {
-            CompactMemTable();
-            return ;
-        }
-
         Compaction* c;
         bool is_manual = (manual_compaction_ != nullptr);
+        if(is_manual && versions_->NumRunningCompactions() > 0) {
+            // 手动compaction需要独占执行，由正在执行的compaction完成后再调度
+            return false;
+        }
         InternalKey manual_end;
         if(is_manual) {
             ManualCompaction* m = manual_compaction_;
@@ -766,6 +942,10 @@ namespace leveldb {
                 (m->done ? "(end)" : manual_end.DebugString().c_str()) );
         } else {
             c = versions_->PickCompaction();
+            if(c != nullptr) {
+                // 可能还有其他不冲突的compaction，继续调度
+                MaybeScheduleCompaction();
+            }
         }
 
         Status status;
@@ -786,9 +966,12 @@ namespace leveldb {
 
             // 将edit应用到当前version
             status = versions_->LogAndApply(c->edit(), &mutex_);
-            if(!status.ok()) {
+            if(status.ok()) {
+                InstallSuperVersion();
+            } else {
                 RecordBackgroundError(status);
             }
+            versions_->ReleaseCompaction(c);
             VersionSet::LevelSummaryStorage tmp;
             Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
                 static_cast<unsigned long long>(f->number), c->level() + 1,
@@ -801,10 +984,12 @@ namespace leveldb {
                 RecordBackgroundError(status);
             }
             CleanupCompaction(compact);
+            versions_->ReleaseCompaction(c);
             c->ReleaseInputs();
             RemoveObsoleteFiles();
         }
 
+        bool did_work = (c != nullptr);
         delete c;
 
         if(status.ok()) {
@@ -826,6 +1011,7 @@ namespace leveldb {
             }
             manual_compaction_ = nullptr;
         }
+        return did_work;
     }
 
     void DBImpl::CleanupCompaction(CompactionState *compact) {
@@ -865,6 +1051,10 @@ namespace leveldb {
         std::string fname = TableFileName(dbname_, file_number);
         Status s = env_->NewWritableFile(fname, &compact->outfile);
         if(s.ok()) {
+            if(options_.rate_limiter != nullptr) {
+                compact->outfile = NewRateLimitedWritableFile(compact->outfile, options_.rate_limiter,
+                                                              RateLimiter::kCompaction);
+            }
             compact->builder = new TableBuilder(options_, compact->outfile);
         }
         return s;
@@ -940,50 +1130,151 @@ namespace leveldb {
                                                  out.smallest, out.largest);
         }
         // 3. 最后将edit应用到当前version
-        return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+        Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+        if(s.ok()) {
+            InstallSuperVersion();
+        }
+        return s;
     }
 
-    // 执行Compaction
-    Status DBImpl::DoCompactionWork(CompactionState *compact) {
-        const uint64_t start_micros = env_->NowMicros();
-        int64_t imm_micros = 0;
-        Log(options_.info_log, "Compacting %d@%d + %d@%d files",
-            compact->compaction->num_input_files(0), compact->compaction->level(),
-            compact->compaction->num_input_files(1), compact->compaction->level() + 1);
+    // 根据输入文件的边界将compaction的key range划分为最多n个数据量大致相同的子范围，
+    // 将相邻子范围之间的分界user key按顺序存入*boundaries，不需要划分时*boundaries为空
+    static void GenerateSubcompactionBoundaries(Compaction* c, const Comparator* ucmp, int n,
+                                                std::vector<std::string>* boundaries) {
+        if(n <= 1) {
+            return;
+        }
+        // 以每个输入文件的最大user key作为候选分界点，并用文件大小估计分界点之前的数据量
+        std::vector<std::pair<Slice, uint64_t>> keys;
+        uint64_t total_bytes = 0;
+        for(int which = 0; which < 2; which++) {
+            for(int i = 0; i < c->num_input_files(which); i++) {
+                FileMetaData* f = c->input(which, i);
+                keys.emplace_back(f->largest.user_key(), f->file_size);
+                total_bytes += f->file_size;
+            }
+        }
+        std::sort(keys.begin(), keys.end(),
+                  [ucmp](const std::pair<Slice, uint64_t>& a, const std::pair<Slice, uint64_t>& b) {
+                      return ucmp->Compare(a.first, b.first) < 0;
+                  });
 
-        assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
-        assert(compact->builder == nullptr);
-        assert(compact->outfile == nullptr);
-        if(snapshots_.empty()) {
-            compact->smallest_snapshot = versions_->LastSequence();
-        } else {
-            compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+        uint64_t bytes_before = 0;
+        for(size_t i = 0; i + 1 < keys.size() && static_cast<int>(boundaries->size()) + 1 < n; i++) {
+            bytes_before += keys[i].second;
+            if(bytes_before * n < total_bytes * (boundaries->size() + 1)) {
+                continue;
+            }
+            // 分界点需严格递增，且不能是整个key range的最大user key，否则最后一个子范围为空
+            if((boundaries->empty() || ucmp->Compare(keys[i].first, boundaries->back()) > 0) &&
+               ucmp->Compare(keys[i].first, keys.back().first) < 0) {
+                boundaries->push_back(keys[i].first.ToString());
+            }
+        }
+    }
+
+    Status DBImpl::RunSubcompactions(CompactionState *compact,
+                                     const std::vector<std::string> &boundaries) {
+        mutex_.AssertHeld();
+        port::CondVar done_signal(&mutex_);
+        std::vector<Subcompaction*> subs;
+        for(size_t i = 0; i <= boundaries.size(); i++) {
+            Subcompaction* sub = new Subcompaction(this, compact->compaction->NewSubcompaction(),
+                                                   &done_signal);
+            sub->compact->smallest_snapshot = compact->smallest_snapshot;
+            sub->input = versions_->MakeInputIterator(sub->compact->compaction);
+            if(i > 0) {
+                sub->begin = boundaries[i - 1];
+                sub->has_begin = true;
+            }
+            if(i < boundaries.size()) {
+                sub->end = boundaries[i];
+                sub->has_end = true;
+            }
+            subs.push_back(sub);
         }
+        Log(options_.info_log, "Compaction split into %d subcompactions",
+            static_cast<int>(subs.size()));
+        mutex_.Unlock();
+
+        // 第一个子compaction在当前线程中执行，其余的各自启动一个线程
+        for(size_t i = 1; i < subs.size(); i++) {
+            env_->StartThread(&DBImpl::BGSubcompactionWork, subs[i]);
+        }
+        BGSubcompactionWork(subs[0]);
 
-        // 构造迭代器来读取compact的input files
-        Iterator* input = versions_->MakeInputIterator(compact->compaction);
+        // 等待所有子compaction完成，按key range的顺序合并输出文件
+        mutex_.Lock();
+        Status status;
+        for(Subcompaction* sub : subs) {
+            while(!sub->done) {
+                done_signal.Wait();
+            }
+            if(status.ok() && !sub->status.ok()) {
+                status = sub->status;
+            }
+            compact->outputs.insert(compact->outputs.end(), sub->compact->outputs.begin(),
+                                    sub->compact->outputs.end());
+            compact->total_bytes += sub->compact->total_bytes;
+            sub->compact->outputs.clear();
+
+            delete sub->input;
+            Compaction* c = sub->compact->compaction;
+            // 输出文件已转移到compact中，这里只清理未完成的builder和outfile
+            CleanupCompaction(sub->compact);
+            c->ReleaseInputs();
+            delete c;
+            delete sub;
+        }
         mutex_.Unlock();
-        input->SeekToFirst();
+        return status;
+    }
+
+    void DBImpl::BGSubcompactionWork(void *arg) {
+        Subcompaction* sub = reinterpret_cast<Subcompaction*>(arg);
+        Slice begin(sub->begin);
+        Slice end(sub->end);
+        Status s = sub->db->ProcessCompactionInputs(sub->compact, sub->input,
+                                                    sub->has_begin ? &begin : nullptr,
+                                                    sub->has_end ? &end : nullptr);
+        MutexLock l(&sub->db->mutex_);
+        sub->status = s;
+        sub->done = true;
+        sub->done_signal->SignalAll();
+    }
+
+    Status DBImpl::ProcessCompactionInputs(CompactionState *compact, Iterator *input,
+                                           const Slice *begin, const Slice *end) {
+        if(begin != nullptr) {
+            InternalKey seek_key(*begin, kMaxSequenceNumber, kValueTypeForSeek);
+            input->Seek(seek_key.Encode());
+        } else {
+            input->SeekToFirst();
+        }
         Status status;
         ParsedInternalKey ikey;
         std::string current_user_key;
         bool has_current_user_key = false;
         SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+        // 已读取但还未向rate_limiter申请额度的字节数
+        int64_t uncharged_read_bytes = 0;
         // 从input files中读取输入
         while(input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
-            if(has_imm_.load(std::memory_order_relaxed)) {
-                const uint64_t  imm_start = env_->NowMicros();
-                mutex_.Lock();
-                if(imm_ != nullptr) {
-                    CompactMemTable();
-                    background_work_finished_signal_.SignalAll();
-                }
-                mutex_.Unlock();
-                imm_micros += (env_->NowMicros() - imm_start);
-            }
-
             // 从input files 的迭代器中读取internal key
             Slice key = input->key();
+            if(end != nullptr &&
+               user_comparator()->Compare(ExtractUserKey(key), *end) >= 0) {
+                // 已超出本次处理的key range
+                break;
+            }
+            if(options_.rate_limiter != nullptr) {
+                // 输入文件的读取经过table cache，无法在文件层面限速，这里按读出的key/value大小批量申请额度
+                uncharged_read_bytes += key.size() + input->value().size();
+                if(uncharged_read_bytes >= kCompactionReadChargeBytes) {
+                    options_.rate_limiter->Request(uncharged_read_bytes, RateLimiter::kCompaction);
+                    uncharged_read_bytes = 0;
+                }
+            }
             if(compact->compaction->ShouldStopBefore(key) &&
                compact->builder != nullptr) {
                 status = FinishCompactionOutputFile(compact, input);
@@ -1059,6 +1350,10 @@ namespace leveldb {
             }
             input->Next();
         }
+        // 循环结束或中途退出时，已读取的剩余字节同样需要计入限速
+        if(uncharged_read_bytes > 0) {
+            options_.rate_limiter->Request(uncharged_read_bytes, RateLimiter::kCompaction);
+        }
 
         if(status.ok() && shutting_down_.load(std::memory_order_acquire)) {
             status = Status::IOError("Deleting DB during compaction");
@@ -1071,11 +1366,41 @@ namespace leveldb {
             status = input->status();
         }
 
-        delete input;
-        input = nullptr;
+        return status;
+    }
+
+    // 执行Compaction
+    Status DBImpl::DoCompactionWork(CompactionState *compact) {
+        const uint64_t start_micros = env_->NowMicros();
+        Log(options_.info_log, "Compacting %d@%d + %d@%d files",
+            compact->compaction->num_input_files(0), compact->compaction->level(),
+            compact->compaction->num_input_files(1), compact->compaction->level() + 1);
+
+        assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
+        assert(compact->builder == nullptr);
+        assert(compact->outfile == nullptr);
+        if(snapshots_.empty()) {
+            compact->smallest_snapshot = versions_->LastSequence();
+        } else {
+            compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+        }
+
+        Status status;
+        std::vector<std::string> boundaries;
+        GenerateSubcompactionBoundaries(compact->compaction, user_comparator(),
+                                        options_.max_subcompactions, &boundaries);
+        if(boundaries.empty()) {
+            // 构造迭代器来读取compact的input files
+            Iterator* input = versions_->MakeInputIterator(compact->compaction);
+            mutex_.Unlock();
+            status = ProcessCompactionInputs(compact, input, nullptr, nullptr);
+            delete input;
+        } else {
+            status = RunSubcompactions(compact, boundaries);
+        }
 
         CompactionStats stats;
-        stats.micros = env_->NowMicros() - start_micros - imm_micros;
+        stats.micros = env_->NowMicros() - start_micros;
         for(int which = 0; which < 2; which++) {
             for(int i = 0; i< compact->compaction->num_input_files(which); i++) {
                 stats.bytes_read += compact->compaction->input(which, i)->file_size;
@@ -1099,67 +1424,119 @@ namespace leveldb {
         return status;
     }
 
-    namespace {
+    void DBImpl::InstallSuperVersion() {
+        mutex_.AssertHeld();
+        SuperVersion* sv = new SuperVersion;
+        sv->mem = mem_;
+        sv->mem->Ref();
+        sv->imms.assign(imm_.rbegin(), imm_.rend());
+        for(MemTable* imm : sv->imms) {
+            imm->Ref();
+        }
+        sv->current = versions_->current();
+        sv->current->Ref();
+        sv->refs.store(1, std::memory_order_relaxed);
+        sv->version_number = super_version_number_.load(std::memory_order_relaxed) + 1;
+
+        SuperVersion* old = super_version_;
+        super_version_ = sv;
+        super_version_number_.store(sv->version_number, std::memory_order_release);
+
+        // 清除各线程缓存的旧SuperVersion，正在被使用的（kSVInUse）由使用者在归还时释放
+        std::vector<void*> cached_svs;
+        local_sv_.Scrape(&cached_svs, kSVObsolete);
+        for(void* ptr : cached_svs) {
+            SuperVersion* cached = static_cast<SuperVersion*>(ptr);
+            if(ptr != kSVInUse && cached->Unref()) {
+                CleanupSuperVersion(cached);
+            }
+        }
+        if(old != nullptr && old->Unref()) {
+            CleanupSuperVersion(old);
+        }
+    }
 
-        // 迭代器的状态，用于保存一个迭代器都引用了哪些对象
-        struct IterState {
-            port::Mutex* const mu;
-            Version* const version GUARDED_BY(mu);
-            MemTable* const mem GUARDED_BY(mu);
-            MemTable* const imm GUARDED_BY(mu);
+    DBImpl::SuperVersion* DBImpl::GetThreadLocalSuperVersion() {
+        // 将槽位标记为使用中，期间若有新的SuperVersion被安装，槽位会被替换为kSVObsolete
+        void* ptr = local_sv_.Swap(kSVInUse);
+        assert(ptr != kSVInUse);
+        SuperVersion* sv = static_cast<SuperVersion*>(ptr);
+        if(sv != nullptr &&
+           sv->version_number != super_version_number_.load(std::memory_order_acquire)) {
+            ReleaseSuperVersion(sv);
+            sv = nullptr;
+        }
+        if(sv == nullptr) {
+            // 缓存失效，加锁获取最新的SuperVersion
+            MutexLock l(&mutex_);
+            sv = super_version_->Ref();
+        }
+        return sv;
+    }
 
-            IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-                : mu(mutex), version(version), mem(mem), imm(imm) {}
-        };
+    void DBImpl::ReturnThreadLocalSuperVersion(SuperVersion *sv) {
+        void* expected = kSVInUse;
+        if(local_sv_.CompareAndSwap(sv, expected)) {
+            // 放回缓存，由缓存继续持有这个引用
+            return;
+        }
+        // 使用期间被InstallSuperVersion()清除了，sv已经不是最新的，释放这个引用
+        assert(expected == kSVObsolete);
+        ReleaseSuperVersion(sv);
+    }
 
-        // 清零函数，用于将一个迭代器所引用的对象的引用数都减1
-        static void CleanupIteratorState(void* arg1, void* arg2) {
-            IterState* state = reinterpret_cast<IterState*>(arg1);
-            // 将迭代器引用对象的引用量都减1
-            state->mu->Lock();
-            state->mem->Unref();
-            if(state->imm != nullptr) {
-                state->imm->Unref();
-            }
-            state->version->Unref();
-            state->mu->Unlock();
-            delete state;
+    void DBImpl::ReleaseSuperVersion(SuperVersion *sv) {
+        if(sv->Unref()) {
+            MutexLock l(&mutex_);
+            CleanupSuperVersion(sv);
         }
-    } // end namespace
+    }
+
+    void DBImpl::CleanupSuperVersion(SuperVersion *sv) {
+        sv->mem->Unref();
+        for(MemTable* imm : sv->imms) {
+            imm->Unref();
+        }
+        sv->current->Unref();
+        delete sv;
+    }
+
+    void DBImpl::CleanupSuperVersionRef(void *arg1, void *arg2) {
+        DBImpl* db = reinterpret_cast<DBImpl*>(arg1);
+        db->ReleaseSuperVersion(reinterpret_cast<SuperVersion*>(arg2));
+    }
 
     // 获取读取整个DB的MergingIterator迭代器
     Iterator* DBImpl::NewInternalIterator(const ReadOptions &options,
                                           SequenceNumber *latest_snapshot,
-                                          uint32_t *seed) {
-        mutex_.Lock();
+                                          uint32_t *seed,
+                                          ScanTracker *scan_tracker) {
+        // 先读取序号再获取SuperVersion，保证序号不超过latest_snapshot的数据都在SuperVersion中
         *latest_snapshot = versions_->LastSequence();
+        // 迭代器的生命周期较长，单独持有一个引用，不占用线程缓存
+        SuperVersion* sv = GetThreadLocalSuperVersion();
+        sv->Ref();
+        ReturnThreadLocalSuperVersion(sv);
 
         // 收集所有需要的子迭代器
         std::vector<Iterator*> list;
         // 1. 首先是memtable的迭代器
-        list.push_back(mem_->NewIterator());
-        mem_->Ref();
-        // 2. 然后是immutable memtable的迭代器
-        if(imm_ != nullptr) {
-            list.push_back(imm_->NewIterator());
-            imm_->Ref();
+        list.push_back(sv->mem->NewIterator());
+        // 2. 然后是各个immutable memtable的迭代器
+        for(MemTable* imm : sv->imms) {
+            list.push_back(imm->NewIterator());
         }
         // 3. 最后是sstable的迭代器
-        versions_->current()->AddIterators(options, &list);
+        sv->current->AddIterators(options, &list, scan_tracker);
 
         // 将收集起来的子迭代器构成一个MergingIterator
         Iterator* internal_iter =
                 NewMergingIterator(&internal_comparator_, &list[0], list.size());
 
-        versions_->current()->Ref();
-
-        // 因为迭代器会引用memtable，immutable memtable以及version，使用完后要对其引用数量减1，
-        // 下面是对构造的合并迭代器注册一个清理函数，来一块把相关的引用数量减1
-        IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
-        internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
+        // 迭代器销毁时释放对SuperVersion的引用
+        internal_iter->RegisterCleanup(CleanupSuperVersionRef, this, sv);
 
-        *seed = ++seed_;
-        mutex_.Unlock();
+        *seed = seed_.fetch_add(1, std::memory_order_relaxed) + 1;
         return internal_iter;
     }
 
@@ -1175,10 +1552,21 @@ namespace leveldb {
     }
 
     Status DBImpl::Get(const ReadOptions &options, const Slice &key, std::string *value) {
+        // 未被pin住的value直接写入*value，被pin住的value拷贝一次后立即释放
+        PinnableSlice pinnable_value(value);
+        Status s = Get(options, key, &pinnable_value);
+        if(s.ok() && pinnable_value.IsPinned()) {
+            value->assign(pinnable_value.data(), pinnable_value.size());
+        }
+        return s;
+    }
+
+    Status DBImpl::Get(const ReadOptions &options, const Slice &key, PinnableSlice *value) {
+        assert(!value->IsPinned());
         // s用于保存查询的状态
         Status s;
-        MutexLock l(&mutex_);
-        // snapshot是一个序号用于限制查询范围，也即将查询范围限制在不超过此序号的那些entry
+        // snapshot是一个序号用于限制查询范围，也即将查询范围限制在不超过此序号的那些entry。
+        // 需要在获取SuperVersion之前读取，保证序号不超过snapshot的数据都在SuperVersion中
         SequenceNumber snapshot;
         if(options.snapshot != nullptr) {
             snapshot =
@@ -1187,63 +1575,139 @@ namespace leveldb {
             snapshot = versions_->LastSequence();
         }
 
-        // 增加引用计数
-        MemTable* mem = mem_;
-        MemTable* imm = imm_;
-        Version* current = versions_->current();
-        mem->Ref();
-        if(imm != nullptr) {
-            imm->Ref();
-        }
-        current->Ref();
+        // 通常情况下直接使用线程缓存的SuperVersion，不需要加锁
+        SuperVersion* sv = GetThreadLocalSuperVersion();
 
-        bool have_stat_update = false;
         Version::GetStats stats;
+        stats.seek_file = nullptr;
 
-        // 当读取sstable和memtable时需要上锁
-        {
-            mutex_.Unlock();
-            LookupKey lkey(key, snapshot);
-            if(mem->Get(lkey, value, &s)) {
-                // 1. 查询memtable;
-                // 查询完毕，在memtable中查到数据
-            } else if(imm->Get(lkey, value, &s)) {
-                // 2. 查询immutable memtable;
-                // 查询完毕，在immtable memtable中查到数据
-            } else {
-                // 3. 在当前的Version中查询SSTables;
-                s = current->Get(options, lkey, value, &stats);
-                have_stat_update = true;
+        LookupKey lkey(key, snapshot);
+        // 1. 查询memtable;
+        Slice mem_value;
+        bool found = sv->mem->Get(lkey, &mem_value, &s);
+        // 2. 依次查询各个immutable memtable;
+        for(size_t i = 0; !found && i < sv->imms.size(); i++) {
+            found = sv->imms[i]->Get(lkey, &mem_value, &s);
+        }
+        if(found) {
+            if(s.ok()) {
+                // value位于memtable的arena中，额外持有一个SuperVersion的引用使memtable在value被释放前保持有效
+                sv->Ref();
+                value->PinSlice(mem_value, &DBImpl::CleanupSuperVersionRef, this, sv);
             }
-            mutex_.Lock();
+        } else {
+            // 3. 在当前的Version中查询SSTables;
+            s = sv->current->Get(options, lkey, value, &stats);
         }
 
         // 更新状态，本次查询可能会带来无效查询，而无效查询可能会触发seek compaction
-        if(have_stat_update && current->UpdateStats(stats)) {
-            MaybeScheduleCompaction();
+        if(stats.seek_file != nullptr) {
+            MutexLock l(&mutex_);
+            if(sv->current->UpdateStats(stats)) {
+                MaybeScheduleCompaction();
+            }
         }
 
-        // 减少引用计数
-        mem->Unref();
-        if(imm != nullptr) {
-            imm->Unref();
+        ReturnThreadLocalSuperVersion(sv);
+        return s;
+    }
+
+    void DBImpl::MultiGet(const ReadOptions &options, const std::vector<Slice> &keys,
+                          std::vector<std::string> *values, std::vector<Status> *statuses) {
+        const size_t n = keys.size();
+        values->assign(n, std::string());
+        statuses->assign(n, Status());
+        if(n == 0) {
+            return;
         }
-        current->Unref();
 
-        return s;
+        SequenceNumber snapshot;
+        if(options.snapshot != nullptr) {
+            snapshot =
+                    static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+        } else {
+            snapshot = versions_->LastSequence();
+        }
+
+        // 整个批次使用同一个SuperVersion
+        SuperVersion* sv = GetThreadLocalSuperVersion();
+
+        Version::GetStats stats;
+        stats.seek_file = nullptr;
+
+        // 按照user key排序，使得SSTable中落在同一个文件、同一个data block中的key相邻
+        const Comparator* ucmp = user_comparator();
+        std::vector<size_t> order(n);
+        for(size_t i = 0; i < n; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return ucmp->Compare(keys[a], keys[b]) < 0;
+        });
+
+        // LookupKey不可拷贝，使用deque保证其地址不变
+        std::deque<LookupKey> lkeys;
+        std::vector<const LookupKey*> table_keys;
+        std::vector<std::string*> table_values;
+        std::vector<Status*> table_statuses;
+        for(size_t index : order) {
+            lkeys.emplace_back(keys[index], snapshot);
+            const LookupKey& lkey = lkeys.back();
+            std::string* value = &(*values)[index];
+            Status* s = &(*statuses)[index];
+            // 1. 查询memtable; 2. 依次查询各个immutable memtable
+            bool found = sv->mem->Get(lkey, value, s);
+            for(size_t i = 0; !found && i < sv->imms.size(); i++) {
+                found = sv->imms[i]->Get(lkey, value, s);
+            }
+            if(!found) {
+                table_keys.push_back(&lkey);
+                table_values.push_back(value);
+                table_statuses.push_back(s);
+            }
+        }
+        // 3. 剩余的key一起在当前的Version中查询SSTables
+        if(!table_keys.empty()) {
+            sv->current->MultiGet(options, table_keys, table_values, table_statuses, &stats);
+        }
+
+        if(stats.seek_file != nullptr) {
+            MutexLock l(&mutex_);
+            if(sv->current->UpdateStats(stats)) {
+                MaybeScheduleCompaction();
+            }
+        }
+
+        ReturnThreadLocalSuperVersion(sv);
+    }
+
+    static void DeleteScanTracker(void* arg1, void*) {
+        delete reinterpret_cast<ScanTracker*>(arg1);
     }
 
     Iterator* DBImpl::NewIterator(const ReadOptions &options) {
         SequenceNumber latest_snapshot;
         uint32_t seed;
+        // 由DB迭代器在Seek时重置，统计其下所有SSTable的迭代器读取的data block
+        ScanTracker* scan_tracker = nullptr;
+        if(options_.scan_fill_cache_limit > 0) {
+            scan_tracker = new ScanTracker(options_.scan_fill_cache_limit);
+        }
         // 构造读取DB的MergingIterator
-        Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+        Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed, scan_tracker);
+        if(scan_tracker != nullptr) {
+            iter->RegisterCleanup(&DeleteScanTracker, scan_tracker, nullptr);
+        }
         // 对MergingIterator迭代器进行封装
+        // 前缀迭代器遇到前缀不同的key即失效
+        const SliceTransform* prefix_extractor =
+                (options.prefix_same_as_start && options_.prefix_extractor != nullptr)
+                ? internal_prefix_extractor_.user_transform() : nullptr;
         return NewDBIterator(this, user_comparator(), iter,
                              (options.snapshot != nullptr ?
                              static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number() :
                              latest_snapshot),
-                             seed );
+                             seed, prefix_extractor, scan_tracker);
     }
 
     // 采样，检查是否会触发compact
@@ -1275,6 +1739,10 @@ namespace leveldb {
     }
 
     Status DBImpl::Write(const WriteOptions &options, WriteBatch *updates) {
+        if(options_.enable_pipelined_write) {
+            return PipelinedWrite(options, updates);
+        }
+
         Writer w(&mutex_);
         w.batch = updates;
         w.sync = options.sync;
@@ -1283,8 +1751,12 @@ namespace leveldb {
         // 将w加入写队列的尾部
         MutexLock l(&mutex_);
         writers_.push_back(&w);
-        while(!w.done && &w != writers_.front()) {
+        // 流水线写入时，已被移出writers_的writer仍可能在此等待，所以需要判断队列是否为空
+        while(!w.done && (writers_.empty() || &w != writers_.front())) {
             w.cv.Wait();
+            if(w.insert_mem != nullptr) {
+                InsertWriterBatch(&w);
+            }
         }
         if(w.done) {
             return w.status;
@@ -1295,7 +1767,7 @@ namespace leveldb {
         Writer* last_writer = &w;
         if(status.ok() && updates != nullptr) {
             // 从写队列的首部开始选择多个writer的batch聚合为一个batch，last_writer标记还未被聚合的结束位置
-            WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+            WriteBatch* write_batch = BuildBatchGroup(&last_writer, tmp_batch_);
             WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
             last_sequence += WriteBatchInternal::Count(write_batch);
 
@@ -1312,7 +1784,7 @@ namespace leveldb {
                     }
                 }
                 // 再插入到memtable
-                if(status.ok()) {
+                if(status.ok() && !options_.allow_concurrent_memtable_write) {
                     status = WriteBatchInternal::InsertInto(write_batch, mem_);
                 }
                 mutex_.Lock();
@@ -1320,6 +1792,19 @@ namespace leveldb {
                     RecordBackgroundError(status);
                 }
             }
+            // 由组内各writer并行插入memtable
+            if(status.ok() && options_.allow_concurrent_memtable_write) {
+                std::vector<Writer*> followers;
+                for(Writer* writer : writers_) {
+                    if(writer != &w) {
+                        followers.push_back(writer);
+                    }
+                    if(writer == last_writer) {
+                        break;
+                    }
+                }
+                status = InsertGroupIntoMemTable(&w, followers, write_batch, mem_);
+            }
 
             if(write_batch == tmp_batch_) {
                 tmp_batch_->Clear();
@@ -1350,9 +1835,184 @@ namespace leveldb {
         return status;
     }
 
+    // 流水线写入分为两个阶段：
+    // 1. 写log阶段：与Write()相同，writers_队首的writer作为leader合并一组batch并写入log，
+    //    完成后立即将该组移出writers_，使下一组可以开始写log；
+    // 2. 写memtable阶段：已写完log的组按顺序进入memtable_writers_，轮到自己时由leader将
+    //    合并后的batch插入memtable并发布sequence，然后唤醒组内的其他writer。
+    // 这样第N+1组写log与第N组写memtable可以重叠执行，而sequence仍按顺序发布。
+    Status DBImpl::PipelinedWrite(const WriteOptions &options, WriteBatch *updates) {
+        Writer w(&mutex_);
+        w.batch = updates;
+        w.sync = options.sync;
+        w.done = false;
+
+        MutexLock l(&mutex_);
+        writers_.push_back(&w);
+        // 流水线写入时，已被移出writers_的writer仍可能在此等待，所以需要判断队列是否为空
+        while(!w.done && (writers_.empty() || &w != writers_.front())) {
+            w.cv.Wait();
+            if(w.insert_mem != nullptr) {
+                InsertWriterBatch(&w);
+            }
+        }
+        if(w.done) {
+            return w.status;
+        }
+
+        // ================================  写log阶段  ================================
+        Status status = MakeRoomForWrite(updates == nullptr);
+        // 前面的组可能还未发布sequence，已分配的最大sequence记录在memtable_writers_的队尾
+        uint64_t last_sequence = memtable_writers_.empty() ?
+                                 versions_->LastSequence() : memtable_writers_.back()->last_sequence;
+        Writer* last_writer = &w;
+        // 本组合并后的batch，组内writer被移出writers_后下一组会复用tmp_batch_，
+        // 所以这里使用自己的合并空间
+        WriteBatch group_batch;
+        WriteBatch* write_batch = nullptr;
+        if(status.ok() && updates != nullptr) {
+            write_batch = BuildBatchGroup(&last_writer, &group_batch);
+            WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+            last_sequence += WriteBatchInternal::Count(write_batch);
+
+            mutex_.Unlock();
+            status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+            bool sync_error = false;
+            if(status.ok() && options.sync) {
+                status = logfile_->Sync();
+                if(!status.ok()) {
+                    sync_error = true;
+                }
+            }
+            mutex_.Lock();
+            if(sync_error) {
+                RecordBackgroundError(status);
+            }
+
+            if(status.ok()) {
+                w.last_sequence = last_sequence;
+                memtable_writers_.push_back(&w);
+            }
+        }
+
+        // 将本组writer移出writers_，但在写完memtable之前不通知它们完成
+        std::vector<Writer*> group;
+        while(true) {
+            Writer* ready = writers_.front();
+            writers_.pop_front();
+            if(ready != &w) {
+                group.push_back(ready);
+            }
+            if(ready == last_writer) {
+                break;
+            }
+        }
+
+        // 唤醒下一组的leader开始写log
+        if(!writers_.empty()) {
+            writers_.front()->cv.Signal();
+        }
+
+        // ==============================  写memtable阶段  ==============================
+        if(status.ok() && write_batch != nullptr) {
+            while(&w != memtable_writers_.front()) {
+                w.cv.Wait();
+            }
+
+            // memtable只会在memtable_writers_为空时切换，所以此时mem_就是本组写log时的memtable
+            MemTable* mem = mem_;
+            if(options_.allow_concurrent_memtable_write) {
+                status = InsertGroupIntoMemTable(&w, group, write_batch, mem);
+            } else {
+                mutex_.Unlock();
+                status = WriteBatchInternal::InsertInto(write_batch, mem);
+                mutex_.Lock();
+            }
+
+            // 按写log的顺序发布sequence
+            versions_->SetLastSequence(last_sequence);
+            memtable_writers_.pop_front();
+            if(!memtable_writers_.empty()) {
+                memtable_writers_.front()->cv.Signal();
+            } else {
+                memtable_writers_drained_signal_.SignalAll();
+            }
+        }
+
+        for(Writer* ready : group) {
+            ready->status = status;
+            ready->done = true;
+            ready->cv.Signal();
+        }
+
+        return status;
+    }
+
+    // 并发写memtable：leader按合并时的顺序为组内每个writer的batch分配sequence，
+    // 唤醒其他writer与自己同时将各自的batch插入mem，等待全部插入完成后返回遇到的第一个错误。
+    // 组内只有leader自己的batch时直接插入合并后的batch即可。
+    Status DBImpl::InsertGroupIntoMemTable(Writer* leader, const std::vector<Writer*>& followers,
+                                           WriteBatch* write_batch, MemTable* mem) {
+        mutex_.AssertHeld();
+        if(write_batch == leader->batch) {
+            mutex_.Unlock();
+            Status s = WriteBatchInternal::InsertInto(write_batch, mem);
+            mutex_.Lock();
+            return s;
+        }
+
+        SequenceNumber sequence = WriteBatchInternal::Sequence(write_batch);
+        WriteBatchInternal::SetSequence(leader->batch, sequence);
+        sequence += WriteBatchInternal::Count(leader->batch);
+        std::vector<Writer*> inserters;
+        for(Writer* follower : followers) {
+            if(follower->batch == nullptr) {
+                continue;
+            }
+            WriteBatchInternal::SetSequence(follower->batch, sequence);
+            sequence += WriteBatchInternal::Count(follower->batch);
+            follower->insert_mem = mem;
+            follower->leader = leader;
+            inserters.push_back(follower);
+        }
+        assert(sequence == WriteBatchInternal::Sequence(write_batch) +
+                           WriteBatchInternal::Count(write_batch));
+        leader->pending_inserts = static_cast<int>(inserters.size());
+        for(Writer* follower : inserters) {
+            follower->cv.Signal();
+        }
+
+        mutex_.Unlock();
+        Status s = WriteBatchInternal::InsertIntoConcurrently(leader->batch, mem);
+        mutex_.Lock();
+
+        while(leader->pending_inserts > 0) {
+            leader->cv.Wait();
+        }
+        for(Writer* follower : inserters) {
+            if(s.ok() && !follower->status.ok()) {
+                s = follower->status;
+            }
+        }
+        return s;
+    }
+
+    void DBImpl::InsertWriterBatch(Writer* w) {
+        mutex_.AssertHeld();
+        MemTable* mem = w->insert_mem;
+        w->insert_mem = nullptr;
+        mutex_.Unlock();
+        Status s = WriteBatchInternal::InsertIntoConcurrently(w->batch, mem);
+        mutex_.Lock();
+        w->status = s;
+        if(--w->leader->pending_inserts == 0) {
+            w->leader->cv.Signal();
+        }
+    }
+
     // 将多个writer里的小WriteBatch合并成一个大的WriteBatch，last_writer记录最后一个
-    // 加入合并的Writer
-    WriteBatch* DBImpl::BuildBatchGroup(Writer **last_write) {
+    // 加入合并的Writer，多个batch合并时使用scratch作为合并空间
+    WriteBatch* DBImpl::BuildBatchGroup(Writer **last_write, WriteBatch* scratch) {
         mutex_.AssertHeld();
         assert(!writers_.empty());
         Writer* first = writers_.front();
@@ -1384,7 +2044,7 @@ namespace leveldb {
                 // 进行合并
                 if(result == first->batch) {
                     // 合并到一个临时的batch中
-                    result = tmp_batch_;
+                    result = scratch;
                     assert(WriteBatchInternal::Count(result) == 0);
                     WriteBatchInternal::Append(result, first->batch);
                 }
@@ -1394,6 +2054,7 @@ namespace leveldb {
             *last_write = w;
         }
 
+        last_batch_group_size_ = WriteBatchInternal::ByteSize(result);
         // 返回合并结果
         return result;
     }
@@ -1405,27 +2066,45 @@ namespace leveldb {
         bool allow_delay = !force;
         Status s;
         while(true) {
+            write_controller_.Update(versions_->NumLevelFiles(0), versions_->EstimatedCompactionDebt());
             if(!bg_error_.ok()) {
                 s = bg_error_;
                 break;
-            } else if(allow_delay && versions_->NumLevelFiles(0) >= config::kL0_SlowdownWriteTriger) {
-                // 如果允许延迟写入，且L0的文件数量超过kL0_SlowdownWriteTriger则延迟写入（1ms）
-                mutex_.Unlock();
-                env_->SleepForMicroseconds(1000);
-                // 不允许第二次延迟写入，将allow_delay设置为false
-                mutex_.Lock();
+            } else if(allow_delay && write_controller_.NeedsDelay()) {
+                // compaction积压超过了软限制，按照目标速率对写入限速，本组的大小用上一个写入组的大小估算。
+                // 分段睡眠，期间若compaction追上则提前结束等待
+                const uint64_t start_micros = env_->NowMicros();
+                uint64_t delay = write_controller_.GetDelay(start_micros, last_batch_group_size_);
+                while(delay > 0 && write_controller_.NeedsDelay()) {
+                    const uint64_t interval = std::min(delay, kDelayIntervalMicros);
+                    mutex_.Unlock();
+                    env_->SleepForMicroseconds(static_cast<int>(interval));
+                    mutex_.Lock();
+                    delay -= interval;
+                    write_controller_.Update(versions_->NumLevelFiles(0), versions_->EstimatedCompactionDebt());
+                }
+                stall_micros_ += env_->NowMicros() - start_micros;
+                // 每次写入最多限速一次
+                allow_delay = false;
             } else if(!force &&
                       (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
                 // 当前memtable中已没有可用空间
                 break;
-            } else if(imm_ != nullptr) {
-                // 当前的memtable已经被写满了，但是immutable memtable正在被压缩，所以等待
+            } else if(!memtable_writers_.empty()) {
+                // 流水线写入时，前面已写完log的组还在向mem_中插入数据，等它们完成后再切换memtable
+                memtable_writers_drained_signal_.Wait();
+            } else if(imm_.size() + 1 >= static_cast<size_t>(options_.max_write_buffer_number)) {
+                // 当前的memtable已经被写满了，且immutable memtable的数量已达上限，需要等待它们落盘
                 Log(options_.info_log, "Current memtable full; waiting...\n");
+                const uint64_t start_micros = env_->NowMicros();
                 background_work_finished_signal_.Wait();
-            } else if(versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
-                // L0中的文件数量过多
-                Log(options_.info_log, "Too many L0 files; waiting...\n");
+                stall_micros_ += env_->NowMicros() - start_micros;
+            } else if(write_controller_.IsStopped()) {
+                // L0中的文件数量过多或compaction负债达到了硬限制
+                Log(options_.info_log, "Too many L0 files or pending compaction bytes; waiting...\n");
+                const uint64_t start_micros = env_->NowMicros();
                 background_work_finished_signal_.Wait();
+                stall_micros_ += env_->NowMicros() - start_micros;
             } else {
                 // 尝试生成一个新的memtable，并将旧的memtable压缩
                 // 生成新的Memtable的同时也要生成新的日志文件
@@ -1443,13 +2122,14 @@ namespace leveldb {
                 logfile_ = lfile;
                 logfile_number_ = new_log_number;
                 log_ = new log::Writer(lfile);
-                // 前面已经判断过imm_是否不为nullptr，能走到这里说明imm_为nullptr，可将memtable转为immutable memtable
-                // 将旧的memtable作为immutable memtable
-                imm_ = mem_;
-                has_imm_.store(true, std::memory_order_release);
-                mem_ = new MemTable(internal_comparator_);
+                // 前面已经判断过immutable memtable的数量，能走到这里说明还未达到上限，
+                // 将旧的memtable作为immutable memtable加入队尾
+                mem_->SetNextLogNumber(new_log_number);
+                imm_.push_back(mem_);
+                mem_ = NewMemTable();
                 mem_->Ref();
                 force = false;
+                InstallSuperVersion();
                 // 检查是否需要执行compaction操作
                 MaybeScheduleCompaction();
             }
@@ -1502,6 +2182,12 @@ namespace leveldb {
                 }
             }
             return true;
+        } else if(in == "stall-micros") {
+            char buf[50];
+            std::snprintf(buf, sizeof(buf), "%llu",
+                          static_cast<unsigned long long>(stall_micros_));
+            value->append(buf);
+            return true;
         } else if(in == "sstables") {
             *value = versions_->current()->DebugString();
             return true;
@@ -1510,8 +2196,8 @@ namespace leveldb {
             if(mem_) {
                 total_usage += mem_->ApproximateMemoryUsage();
             }
-            if(imm_) {
-                total_usage += imm_->ApproximateMemoryUsage();
+            for(MemTable* imm : imm_) {
+                total_usage += imm->ApproximateMemoryUsage();
             }
             char buf[50];
             std::snprintf(buf, sizeof(buf), "%llu",
@@ -1580,7 +2266,7 @@ namespace leveldb {
                 impl->logfile_number_ = new_log_number;
                 impl->log_ = new log::Writer(lfile);
                 // 创建memtable
-                impl->mem_ = new MemTable(impl->internal_comparator_);
+                impl->mem_ = impl->NewMemTable();
                 impl->mem_->Ref();
             }
         }
@@ -1591,6 +2277,7 @@ namespace leveldb {
             s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
         }
         if(s.ok()) {
+            impl->InstallSuperVersion();
             // 删除旧文件
             impl->RemoveObsoleteFiles();
             // 检查是否需要执行compaction
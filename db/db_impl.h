@@ -9,19 +9,23 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "port/port_stdcxx.h"
+#include "util/thread_local.h"
 
 namespace leveldb {
 
     class MemTable;
+    class ScanTracker;
     class TableCache;
     class Version;
     class VersionSet;
@@ -39,6 +43,9 @@ namespace leveldb {
         Status Delete(const WriteOptions&, const Slice& key) override;
         Status Write(const WriteOptions& options, WriteBatch* updates) override;
         Status Get(const ReadOptions& options, const Slice& key, std::string* value) override;
+        Status Get(const ReadOptions& options, const Slice& key, PinnableSlice* value) override;
+        void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                      std::vector<std::string>* values, std::vector<Status>* statuses) override;
         Iterator* NewIterator(const ReadOptions&) override;
         const Snapshot* GetSnapshot() override;
         void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -56,6 +63,8 @@ namespace leveldb {
     private:
         friend class DB;
         struct CompactionState;
+        struct Subcompaction;
+        struct SuperVersion;
         struct Writer;
 
         // manual compaction 的信息
@@ -84,12 +93,17 @@ namespace leveldb {
             int64_t bytes_written;
         };
 
+        // scan_tracker不为nullptr时，各个SSTable的迭代器读取的data block计入其中
         Iterator* NewInternalIterator(const ReadOptions&,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed);
+                                      uint32_t* seed,
+                                      ScanTracker* scan_tracker = nullptr);
 
         Status NewDB();
 
+        // 创建一个新的memtable，按照Options::memtable_bloom_size_ratio为其分配Bloom filter
+        MemTable* NewMemTable() const;
+
         Status Recover(VersionEdit* edit, bool* save_manifest)
             EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -106,22 +120,64 @@ namespace leveldb {
                               VersionEdit* edit, SequenceNumber* max_sequence)
                               EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-        Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+        // 若pending_number非空，则新文件的编号存入*pending_number并继续保留在pending_outputs_中，
+        // 由调用者在edit生效后移除，避免其他后台线程在此期间将该文件当作垃圾文件删除
+        Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                                uint64_t* pending_number)
                                 EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+        // options_.enable_pipelined_write为true时的写入路径，写log和写memtable分两个阶段执行
+        Status PipelinedWrite(const WriteOptions& options, WriteBatch* updates);
+
         Status MakeRoomForWrite(bool force) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-        WriteBatch* BuildBatchGroup(Writer** last_write) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        WriteBatch* BuildBatchGroup(Writer** last_write, WriteBatch* scratch)
+            EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 将写入组内各writer的batch并行插入mem，write_batch为组内合并后的batch
+        Status InsertGroupIntoMemTable(Writer* leader, const std::vector<Writer*>& followers,
+                                       WriteBatch* write_batch, MemTable* mem)
+            EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 被leader唤醒后，由writer自己将其batch插入memtable
+        void InsertWriterBatch(Writer* w) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
         void RecordBackgroundError(const Status& s);
 
+        // mem_、imm_或current version发生变化后调用，生成新的SuperVersion，并使各线程缓存的旧SuperVersion失效
+        void InstallSuperVersion() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 获取当前线程缓存的SuperVersion，缓存失效时才需要加锁获取最新的SuperVersion。
+        // 使用完后需要调用ReturnThreadLocalSuperVersion()归还
+        SuperVersion* GetThreadLocalSuperVersion() LOCKS_EXCLUDED(mutex_);
+        void ReturnThreadLocalSuperVersion(SuperVersion* sv) LOCKS_EXCLUDED(mutex_);
+        // 减少sv的引用计数，降为0时释放其引用的memtable和version
+        void ReleaseSuperVersion(SuperVersion* sv) LOCKS_EXCLUDED(mutex_);
+        static void CleanupSuperVersion(SuperVersion* sv) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 迭代器及PinnableSlice的清理函数，arg1为DBImpl，arg2为其引用的SuperVersion
+        static void CleanupSuperVersionRef(void* arg1, void* arg2);
+        // 线程退出时由local_sv_调用，释放该线程缓存的SuperVersion
+        static void SuperVersionUnrefHandle(void* ptr);
+
         void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // memtable落盘在Env的HIGH线程池中执行
+        static void BGFlushWork(void* db);
+        void BackgroundFlushCall();
+        // compaction在Env的LOW线程池中执行
         static void BGWork(void* db);
         void BackgroundCall();
-        void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 执行一次compaction，若没有可执行的compaction则返回false
+        bool BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
         void CleanupCompaction(CompactionState* compact)
             EXCLUSIVE_LOCKS_REQUIRED(mutex_);
         Status DoCompactionWork(CompactionState* compact)
             EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        // 合并input中user key位于[begin, end)的数据并写入compact的输出文件，
+        // begin/end为nullptr表示该端不设限制。调用时不持有锁
+        Status ProcessCompactionInputs(CompactionState* compact, Iterator* input,
+                                       const Slice* begin, const Slice* end);
+        // 按boundaries将compaction划分为多个子compaction并行执行，各子compaction的输出
+        // 按key的顺序合并到compact中。调用时持有锁，返回时锁已释放
+        Status RunSubcompactions(CompactionState* compact,
+                                 const std::vector<std::string>& boundaries)
+            EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+        static void BGSubcompactionWork(void* arg);
 
         Status OpenCompactionOutputFile(CompactionState* compact);
         Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
@@ -135,6 +191,7 @@ namespace leveldb {
         Env* env_;
         const InternalKeyComparator internal_comparator_;
         const InternalFilterPolicy internal_filter_policy_;
+        const InternalSliceTransform internal_prefix_extractor_;
         const Options options_;
         const bool owns_info_log_;
         const bool owns_cache_;
@@ -147,21 +204,43 @@ namespace leveldb {
         std::atomic<bool> shutting_down_;
         port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
         MemTable* mem_;
-        MemTable* imm_ GUARDED_BY(mutex_);
-        std::atomic<bool> has_imm_;
+        // 等待落盘的immutable memtable，按生成顺序排列，队首最旧
+        std::deque<MemTable*> imm_ GUARDED_BY(mutex_);
         WritableFile* logfile_;
         uint64_t logfile_number_ GUARDED_BY(mutex_);
         log::Writer* log_;
-        uint32_t seed_ GUARDED_BY(mutex_);
+        // 用于迭代器的读取采样，读操作不持有锁，使用原子变量
+        std::atomic<uint32_t> seed_;
+
+        // 当前的mem_、imm_和current version，读操作通过它访问这三者而不需要持有锁
+        SuperVersion* super_version_ GUARDED_BY(mutex_);
+        // 每安装一个新的SuperVersion加1，线程缓存的SuperVersion编号与之不同时表示已经失效
+        std::atomic<uint64_t> super_version_number_;
+        // 各线程缓存的SuperVersion
+        ThreadLocalPtr local_sv_;
 
         std::deque<Writer*> writers_ GUARDED_BY(mutex_);
         WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+        // 根据compaction的积压情况对写入进行限速或停止写入
+        WriteController write_controller_ GUARDED_BY(mutex_);
+        // 上一个写入组合并后的batch大小，下一组写入前按此大小向write_controller_申请额度
+        uint64_t last_batch_group_size_ GUARDED_BY(mutex_);
+        // 写入因限速或停止而累计等待的时间，单位为微秒
+        uint64_t stall_micros_ GUARDED_BY(mutex_);
+
+        // 流水线写入时，已经写完log、等待按顺序写入memtable的writer组（只保存各组的leader）
+        std::deque<Writer*> memtable_writers_ GUARDED_BY(mutex_);
+        // memtable_writers_被清空时发出信号，切换memtable前需要等待此信号
+        port::CondVar memtable_writers_drained_signal_ GUARDED_BY(mutex_);
+
         SnapshotList snapshots_ GUARDED_BY(mutex_);
 
         std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
-        // 用于标记工作队列中是否已经有一个compaction操作
-        bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+        // 已经放入LOW线程池的工作队列或正在执行的compaction任务数量，不超过options_.max_background_compactions
+        int background_compactions_scheduled_ GUARDED_BY(mutex_);
+        // 用于标记HIGH线程池中是否已经有一个memtable落盘操作，落盘需按顺序进行，同一时刻只有一个
+        bool background_flush_scheduled_ GUARDED_BY(mutex_);
         ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
         VersionSet* const versions_ GUARDED_BY(mutex_);
@@ -10,6 +10,7 @@
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
+#include "table/two_level_iterator.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
@@ -52,11 +53,14 @@ namespace leveldb {
             enum Direction { kForward, kReserve };
 
             DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-                   uint32_t seed)
+                   uint32_t seed, const SliceTransform* prefix_extractor, ScanTracker* scan_tracker)
                    : db_(db),
                      user_comparator_(cmp),
                      iter_(iter),
                      sequence_(s),
+                     prefix_extractor_(prefix_extractor),
+                     prefix_active_(false),
+                     scan_tracker_(scan_tracker),
                      direction_(kForward),
                      valid_(false),
                      rnd_(seed),
@@ -96,6 +100,20 @@ namespace leveldb {
             void FindPrevUserEntry();
             bool ParseKey(ParsedInternalKey* key);
 
+            // 是否已超出Seek()的target的前缀
+            inline bool PrefixExhausted(const Slice& user_key) const {
+                return (!prefix_extractor_->InDomain(user_key) ||
+                        prefix_extractor_->Transform(user_key) != Slice(prefix_));
+            }
+
+            // 前缀迭代器不支持反向移动
+            void PrefixNotSupported() {
+                valid_ = false;
+                status_ = Status::NotSupported("Prev() and SeekToLast() are not supported with prefix_same_as_start");
+                saved_key_.clear();
+                ClearSavedValue();
+            }
+
             inline void SaveKey(const Slice& k, std::string* dst) {
                 dst->assign(k.data(), k.size());
             }
@@ -122,6 +140,13 @@ namespace leveldb {
             // DBIter只能访问到比sequence_小的KV对,
             // 这能方便旧版本（快照）数据库的遍历。
             SequenceNumber const sequence_;
+            // 不为nullptr时为前缀迭代器，见ReadOptions::prefix_same_as_start
+            const SliceTransform* const prefix_extractor_;
+            // 最近一次Seek()的target的前缀，prefix_active_为false时表示target没有前缀或未调用Seek()，按全序遍历
+            std::string prefix_;
+            bool prefix_active_;
+            // 不为nullptr时在每次Seek时重置，由iter_的cleanup函数释放
+            ScanTracker* const scan_tracker_;
             Status status_;
             // 当direction == kReverse时，iter_指向current key的前一个key
             // 当direction_ == kReverse时的current key
@@ -194,6 +219,12 @@ namespace leveldb {
             assert(direction_ == kForward);
             do {
                 ParsedInternalKey ikey;
+                if(prefix_active_ && PrefixExhausted(ExtractUserKey(iter_->key()))) {
+                    // 之后的key都不再具有target的前缀
+                    valid_ = false;
+                    saved_key_.clear();
+                    return ;
+                }
                 // 将当前iter_的internal key解析，并保证其序号小于sequence_
                 if(ParseKey(&ikey) && ikey.sequence <= sequence_) {
                     // 查看数据类型
@@ -230,6 +261,10 @@ namespace leveldb {
         // 向前跳过同一user key的无效数据
         void DBIter::Prev() {
             assert(valid_);
+            if(prefix_extractor_ != nullptr) {
+                PrefixNotSupported();
+                return;
+            }
             if(direction_ == kForward) {
                 // direction == kForward时，iter_指向当前entry，所以只需要前移到一个不同的user key，
                 // 然后在调用FindPrevUserEntry找到这个不同的user key的最新版本即可。
@@ -303,8 +338,16 @@ namespace leveldb {
         }
 
         void DBIter::Seek(const Slice& target) {
+            if(scan_tracker_ != nullptr) {
+                scan_tracker_->Reset();
+            }
             direction_ = kForward;
             ClearSavedValue();
+            prefix_active_ = prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+            if(prefix_active_) {
+                Slice prefix = prefix_extractor_->Transform(target);
+                prefix_.assign(prefix.data(), prefix.size());
+            }
             // 将一个internal key（target）封装到saved_key_
             saved_key_.clear();
             AppendInternalKey(&saved_key_,
@@ -320,8 +363,12 @@ namespace leveldb {
         }
 
         void DBIter::SeekToFirst() {
+            if(scan_tracker_ != nullptr) {
+                scan_tracker_->Reset();
+            }
             direction_ = kForward;
             ClearSavedValue();
+            prefix_active_ = false;
             iter_->SeekToFirst();
             if(!iter_->Valid()) {
                 FindNextUserEntry(false, &saved_key_);
@@ -331,6 +378,13 @@ namespace leveldb {
         }
 
         void DBIter::SeekToLast() {
+            if(prefix_extractor_ != nullptr) {
+                PrefixNotSupported();
+                return;
+            }
+            if(scan_tracker_ != nullptr) {
+                scan_tracker_->Reset();
+            }
             direction_ = kReserve;
             ClearSavedValue();
             iter_->SeekToLast();
@@ -341,8 +395,10 @@ namespace leveldb {
 
     Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                             Iterator* internal_iter, SequenceNumber sequence,
-                            uint32_t seed) {
-        return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                            uint32_t seed, const SliceTransform* prefix_extractor,
+                            ScanTracker* scan_tracker) {
+        return new DBIter(db, user_key_comparator, internal_iter, sequence, seed, prefix_extractor,
+                          scan_tracker);
     }
 
 
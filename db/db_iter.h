@@ -13,10 +13,15 @@
 namespace leveldb {
 
     class DBImpl;
+    class ScanTracker;
 
+    // prefix_extractor不为nullptr时，返回的迭代器在Seek()之后只返回与target前缀相同的user key，
+    // 见ReadOptions::prefix_same_as_start。
+    // scan_tracker不为nullptr时在每次Seek时将其重置，见Options::scan_fill_cache_limit
     Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                             Iterator* internal_iter, SequenceNumber sequence,
-                            uint32_t seed);
+                            uint32_t seed, const SliceTransform* prefix_extractor = nullptr,
+                            ScanTracker* scan_tracker = nullptr);
 
 } // end namespace leveldb
 
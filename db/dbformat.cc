@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <cstdio>
 #include <sstream>
+#include <vector>
 #include "util/coding.h"
 #include "port/port.h"
 
@@ -102,12 +103,18 @@ namespace leveldb {
     const char* InternalFilterPolicy::Name() const { return user_policy_->Name(); }
 
     void InternalFilterPolicy::CreateFilter(const Slice* keys, int n, std::string* dst) const {
-        // 传入的keys是internal key，需要先提取出user key
+        // 传入的keys是internal key，需要先提取出user key。
+        // 同一个user key的多个版本以及相同的前缀是相邻的，去掉连续重复的user key以免filter被不必要地放大
         Slice* mkey = const_cast<Slice*>(keys);
+        int count = 0;
         for(int i=0; i<n; i++) {
-            mkey[i] = ExtractUserKey(keys[i]);
+            Slice user_key = ExtractUserKey(keys[i]);
+            if(count > 0 && mkey[count - 1] == user_key) {
+                continue;
+            }
+            mkey[count++] = user_key;
         }
-        user_policy_->CreateFilter(keys, n, dst);
+        user_policy_->CreateFilter(keys, count, dst);
     }
 
     bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
@@ -115,6 +122,29 @@ namespace leveldb {
         return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
     }
 
+    void InternalFilterPolicy::KeysMayMatch(int n, const Slice* keys, const Slice& f, bool* may_match) const {
+        std::vector<Slice> user_keys(n);
+        for(int i = 0; i < n; i++) {
+            user_keys[i] = ExtractUserKey(keys[i]);
+        }
+        user_policy_->KeysMayMatch(n, user_keys.data(), f, may_match);
+    }
+
+    const char* InternalSliceTransform::Name() const { return user_transform_->Name(); }
+
+    Slice InternalSliceTransform::Transform(const Slice& key) const {
+        const Slice prefix = user_transform_->Transform(ExtractUserKey(key));
+        return Slice(key.data(), prefix.size() + 8);
+    }
+
+    bool InternalSliceTransform::InDomain(const Slice& key) const {
+        return user_transform_->InDomain(ExtractUserKey(key));
+    }
+
+    bool InternalSliceTransform::SamePrefix(const Slice& a, const Slice& b) const {
+        return user_transform_->SamePrefix(ExtractUserKey(a), ExtractUserKey(b));
+    }
+
     LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) {
         // 获取user key的长度
         size_t usize = user_key.size();
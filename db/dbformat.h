@@ -9,6 +9,7 @@
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/slice.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
 #include "util/logging.h"
@@ -20,10 +21,6 @@ namespace leveldb {
         static const int kNumLevels = 7;
         // Level-0 文件数量阈值，超过此值将执行Compaction
         static const int kL0_CompactionTrigger = 4;
-        // 对 Level-0 文件的数量进行软限制，此时，限制写入速度
-        static const int kL0_SlowdownWriteTriger = 8;
-        // Level-0 的最大文件数量，此时将停止写入
-        static const int kL0_StopWritesTrigger = 12;
         // Minor Compaction输出的sstable最大将被放置到哪个level
         // Maximum level to which a new compacted memtable is pushed if it
         // does not create overlap.  We try to push to level 2 to avoid the
@@ -110,6 +107,24 @@ namespace leveldb {
         const char* Name() const override;
         void CreateFilter(const Slice* keys, int n, std::string* dst) const override;
         bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
+        void KeysMayMatch(int n, const Slice* keys, const Slice& filter, bool* may_match) const override;
+    };
+
+    // 将user key的前缀提取器包装为作用于internal key的提取器。
+    // filter中的key都会经过InternalFilterPolicy去掉末尾的8个字节，因此对于internal key，
+    // Transform()返回的是user key的前缀再加上其后的8个字节，去掉这8个字节后即为user key的前缀
+    class InternalSliceTransform : public SliceTransform {
+        private:
+        const SliceTransform* const user_transform_;
+
+        public:
+        explicit InternalSliceTransform(const SliceTransform* t) : user_transform_(t) {}
+        const SliceTransform* user_transform() const { return user_transform_; }
+        const char* Name() const override;
+        Slice Transform(const Slice& key) const override;
+        bool InDomain(const Slice& key) const override;
+        // 只比较user key的前缀，忽略末尾的8个字节
+        bool SamePrefix(const Slice& a, const Slice& b) const override;
     };
 
     // InternalKey用于封装user key，以按照相应的规则进行比较
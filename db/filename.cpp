@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <random>
 
 #include "db/dbformat.h"
 #include "leveldb/env.h"
@@ -73,11 +74,16 @@ namespace leveldb {
         return dbname + "/LOG.old";
     }
 
+    std::string IdentityFileName(const std::string& dbname) {
+        return dbname + "/IDENTITY";
+    }
+
 
     // 如果filename是一个leveldb的文件，则将其文件类型存储在*type中，文件编号存在*number中；
     // 如果成功解析此文件，则返回true，否则返回false。
     // 所有的文件格式为：
     //    dbname/CURRENT
+    //    dbname/IDENTITY
     //    dbname/LOCK
     //    dbname/LOG
     //    dbname/LOG.old
@@ -88,6 +94,9 @@ namespace leveldb {
         if(rest == "CURRENT") {
             *number = 0;
             *type = kCurrentFile;
+        } else if(rest == "IDENTITY") {
+            *number = 0;
+            *type = kIdentityFile;
         } else if(rest == "LOCK") {
             *number = 0;
             *type = kDBLockFile;
@@ -147,4 +156,29 @@ namespace leveldb {
         }
         return s;
     }
+
+    Status GetOrCreateDBIdentity(Env* env, const std::string& dbname, std::string* identity) {
+        const std::string fname = IdentityFileName(dbname);
+        Status s;
+        if(env->FileExists(fname)) {
+            s = ReadFileToString(env, fname, identity);
+            if(!s.ok()) {
+                return s;
+            }
+            while(!identity->empty() && (identity->back() == '\n' || identity->back() == ' ')) {
+                identity->pop_back();
+            }
+            if(!identity->empty()) {
+                return s;
+            }
+        }
+        // 由创建时间与随机数组成，写入中途崩溃留下的空文件会被重新生成
+        std::random_device rd;
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%016llx-%08x%08x",
+                      static_cast<unsigned long long>(env->NowMicros()),
+                      static_cast<unsigned int>(rd()), static_cast<unsigned int>(rd()));
+        *identity = buf;
+        return WriteStringToFileSync(env, *identity + "\n", fname);
+    }
 } // end namespace leveldb
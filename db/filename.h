@@ -25,7 +25,8 @@ namespace leveldb {
         kDescriptorFile,
         kCurrentFile,
         kTempFile,
-        kInfoLogFile
+        kInfoLogFile,
+        kIdentityFile
     };
 
     // 返回名称为dbname的数据库中编号为number的log file的文件名；
@@ -62,12 +63,19 @@ namespace leveldb {
     // 返回名称为dbname的数据库中的old info log file name
     std::string OldInfoLogFileName(const std::string& dbname);
 
+    // 返回名称为dbname的数据库中identity file的文件名，此文件保存了数据库创建时生成的唯一标识
+    std::string IdentityFileName(const std::string& dbname);
+
     // 如果filename是一个leveldb的文件，则将其文件类型存储在*type中，文件编号存在*number中；
     // 如果成功解析此文件，则返回true，否则返回false。
     bool ParseFileName(const std::string& filename, uint64_t* number, FileType* type);
 
     // 设置CURRENT文件指向descriptor_number所对应的descriptor file
     Status SetCurrentFile(Env* env, const std::string& dbname, uint64_t descriptor_number);
+
+    // 读取数据库的唯一标识并存入*identity，identity file不存在或为空时生成一个新的标识并写入。
+    // 删除并重新创建同名的数据库后标识会发生变化
+    Status GetOrCreateDBIdentity(Env* env, const std::string& dbname, std::string* identity);
 }
 
 
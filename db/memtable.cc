@@ -1,5 +1,6 @@
 
 #include "db/memtable.h"
+#include <new>
 #include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
@@ -19,8 +20,14 @@ namespace leveldb {
         return Slice(p, len);
     }
 
-    MemTable::MemTable(const InternalKeyComparator& comparator)
-        : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    MemTable::MemTable(const InternalKeyComparator& comparator, uint32_t bloom_bits)
+        : comparator_(comparator), refs_(0), next_log_number_(0), table_(comparator_, &arena_),
+          bloom_(nullptr) {
+        if(bloom_bits > 0) {
+            // filter的空间从arena_中分配，计入memtable的内存使用量
+            bloom_ = new (arena_.AllocateAligned(sizeof(DynamicBloom))) DynamicBloom(&arena_, bloom_bits);
+        }
+    }
     
     MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -77,7 +84,17 @@ namespace leveldb {
 
     
 
-    void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key, const Slice& value) {
+    // 计算数据项编码后的字节长度
+    static size_t EncodedEntryLength(const Slice& key, const Slice& value) {
+        // seq 7 + type 1 = 8
+        size_t internal_key_size = key.size() + 8;
+        return VarintLength(internal_key_size) + internal_key_size +
+               VarintLength(value.size()) + value.size();
+    }
+
+    // 将数据项编码到buf中，buf的长度为EncodedEntryLength(key, value)
+    static void EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                            const Slice& key, const Slice& value) {
         // Format of an entry is concatenation of:
         //  key_size     : varint32 of internal_key.size()
         //  key bytes    : char[internal_key.size()]
@@ -89,12 +106,6 @@ namespace leveldb {
         size_t val_size = value.size();
         // seq 7 + type 1 = 8
         size_t internal_key_size = key_size + 8;
-        // 计算编码后的字节长度: 数据的实际大小+其长度所占用的大小
-        const size_t encoded_len = VarintLength(internal_key_size) +
-                                   internal_key_size + VarintLength(val_size) + val_size;
-        
-        // 从内存池分配空间
-        char* buf = arena_.Allocate(encoded_len);
         //将internal key的长度存入buf，返回的p是当前指针的位置
         char* p = EncodeVarint32(buf, internal_key_size);
         // 继续将internal key的数据部分存入
@@ -109,12 +120,52 @@ namespace leveldb {
         p = EncodeVarint32(p, val_size);
         // 将value的数据存入
         std::memcpy(p, value.data(), val_size);
-        assert(p + val_size == buf + encoded_len);
+        assert(p + val_size == buf + EncodedEntryLength(key, value));
+    }
+
+    void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key, const Slice& value) {
+        // 计算编码后的字节长度: 数据的实际大小+其长度所占用的大小
+        const size_t encoded_len = EncodedEntryLength(key, value);
+        // 从内存池分配空间
+        char* buf = arena_.Allocate(encoded_len);
+        EncodeEntry(buf, s, type, key, value);
+        // 先加入filter再插入跳表，key在跳表中可见时filter中一定已经包含它
+        if(bloom_ != nullptr) {
+            bloom_->Add(key);
+        }
         table_.Insert(buf);
     }
 
+    void MemTable::AddConcurrently(SequenceNumber s, ValueType type, const Slice& key, const Slice& value) {
+        const size_t encoded_len = EncodedEntryLength(key, value);
+        char* buf = arena_.AllocateConcurrently(encoded_len);
+        EncodeEntry(buf, s, type, key, value);
+        if(bloom_ != nullptr) {
+            bloom_->AddConcurrently(key);
+        }
+        table_.InsertConcurrently(buf);
+    }
+
     // 根据lookup key查询，将查找到的值存入*value，状态码存入*s
     bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+        Slice v;
+        Status found;
+        if(!Get(key, &v, &found)) {
+            return false;
+        }
+        if(found.ok()) {
+            value->assign(v.data(), v.size());
+        } else {
+            *s = found;
+        }
+        return true;
+    }
+
+    bool MemTable::Get(const LookupKey& key, Slice* value, Status* s) {
+        // filter中没有该user key时不必查找跳表
+        if(bloom_ != nullptr && !bloom_->MayContain(key.user_key())) {
+            return false;
+        }
         // 获取memtable key : key length + user key + tag
         Slice memkey = key.memtable_key();
         // 创建当前跳表的迭代器
@@ -143,9 +194,8 @@ namespace leveldb {
                 // 根据value的类型处理
                 switch(static_cast<ValueType>(tag & 0xff)) {
                     case kTypeValue: {
-                        // 提取value
-                        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-                        value->assign(v.data(), v.size());
+                        // 提取value，其位于arena中，在memtable销毁前一直有效
+                        *value = GetLengthPrefixedSlice(key_ptr + key_length);
                         return true;
                     }
                     case kTypeDeletion: {
@@ -154,7 +204,7 @@ namespace leveldb {
                     }
                 }
             }
-            return false;
         }
+        return false;
     }
 } // end namespace leveldb 
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "leveldb/iterator.h"
 #include "leveldb/db.h"
 #include "util/arena.h"
+#include "util/dynamic_bloom.h"
 
 namespace leveldb {
 
@@ -18,7 +19,8 @@ namespace leveldb {
         public:
         // MemTable会通过引用计数的，初始化时引用计数为0，每次被调用必须先调用Ref()来增加一次引用，
         // 引用计数不为0则不能被删除。
-        explicit MemTable(const InternalKeyComparator& comparator);
+        // bloom_bits大于0时，使用该大小的Bloom filter记录加入的user key，使Get()可以跳过不存在的key
+        explicit MemTable(const InternalKeyComparator& comparator, uint32_t bloom_bits = 0);
 
         MemTable(const MemTable&) = delete;
         MemTable& operator=(const MemTable&) = delete;
@@ -48,11 +50,22 @@ namespace leveldb {
         // 向Memtable中添加数据项，按照特定的seq和type将key映射到value
         // 需要注意的是，当type==kTypeDeletion时，value是空值
         void Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value);
+
+        // Add()的并发版本，允许多个线程同时向同一个Memtable中添加数据项，
+        // 调用者需保证它不会与Add()同时被调用
+        void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value);
         
         // 如果Memtable包含key的value，则将value存到*value并返回true
         // 若Memtable中存的是有删除标记的key，则在*status中保存一个NotFound()错误，并返回true
         // 否则返回false
         bool Get(const LookupKey& key, std::string* value, Status* s);
+        // 与上面的Get相同，但不拷贝value，*value直接引用memtable中的数据，在memtable销毁前一直有效
+        bool Get(const LookupKey& key, Slice* value, Status* s);
+
+        // 该memtable转为immutable memtable时新创建的log文件编号。
+        // 该memtable落盘后，编号小于它的log文件就不再需要了
+        void SetNextLogNumber(uint64_t number) { next_log_number_ = number; }
+        uint64_t GetNextLogNumber() const { return next_log_number_; }
 
         private:
         friend class MemTableIterator;
@@ -69,8 +82,11 @@ namespace leveldb {
 
         KeyComparator comparator_;
         int refs_;
+        uint64_t next_log_number_;
         Arena arena_;
         Table table_;
+        // 记录加入的user key，未启用时为nullptr
+        DynamicBloom* bloom_;
     };
 
 } // end namespace leveldb 
@@ -4,6 +4,8 @@
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
+#include <thread>
 
 #include "util/arena.h"
 #include "util/random.h"
@@ -29,6 +31,11 @@ namespace leveldb {
 
         // 插入一个key
         void Insert(const Key& key);
+        // 插入一个key，允许多个线程同时调用，也允许与读操作并发进行。
+        // 每一层通过CAS将新节点链接到前驱节点之后，CAS失败时从原前驱节点
+        // 开始重新查找该层的插入位置。
+        // 调用者需保证它不会与Insert()同时被调用。
+        void InsertConcurrently(const Key& key);
         // 检查是否包含指定的key
         bool Contains(const Key& key) const;
 
@@ -87,6 +94,9 @@ namespace leveldb {
 
         Node* NewNode(const Key& key, int height);
         int RandomHeight();
+        // 并发插入使用的版本：从arena中线程安全地分配节点，并使用线程私有的随机数生成器
+        Node* NewNodeConcurrently(const Key& key, int height);
+        int RandomHeightConcurrently();
 
         // 判断两个key是否相等
         bool Equal(const Key& a, const Key& b) const {
@@ -110,6 +120,10 @@ namespace leveldb {
         // 找到最后一个节点
         // 如果为空链表则返回head_
         Node* FindLast() const ;
+        // 从节点before开始，在第level层查找key的插入位置，
+        // 将该层最后一个小于key的节点存入*out_prev，其后继节点存入*out_next
+        void FindSpliceForLevel(const Key& key, Node* before, int level,
+                                Node** out_prev, Node** out_next) const ;
 
 
     }; // end class SkipList
@@ -146,6 +160,12 @@ namespace leveldb {
             next_[n].store(x, std::memory_order_relaxed);
         }
 
+        // 若第n层的后继节点仍为expected，则将其替换为x并返回true
+        bool CASNext(int n, Node* expected, Node* x) {
+            assert(n >= 0);
+            return next_[n].compare_exchange_strong(expected, x);
+        }
+
         
         private:
         // 数组的长度与跳表当前的高度相同，存储的是节点所在当前层的下一个节点
@@ -163,6 +183,15 @@ namespace leveldb {
         return new (node_memory)Node(key);
     }
 
+    template <typename Key, class Comparator>
+    typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNodeConcurrently(
+        const Key& key, int height) {
+        char* const node_memory = arena_->AllocateAlignedConcurrently(
+            sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1)
+        );
+        return new (node_memory)Node(key);
+    }
+
     // ======================  SkipList内部Iterator工具类的内部实现  ============================
     template <typename Key, class Comparator>
     inline SkipList<Key, Comparator>::Iterator::Iterator(const SkipList* list) {
@@ -238,6 +267,21 @@ namespace leveldb {
         return height;
     }
 
+    template <typename Key, class Comparator>
+    int SkipList<Key, Comparator>::RandomHeightConcurrently() {
+        static const unsigned int kBranching = 4;
+        // rnd_不是线程安全的，并发插入时每个线程使用自己的随机数生成器
+        static thread_local Random rnd(static_cast<uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())));
+        int height = 1;
+        while(height < kMaxHeight && ((rnd.Next() % kBranching) == 0)) {
+            height++;
+        }
+        assert(height > 0);
+        assert(height <= kMaxHeight);
+        return height;
+    }
+
     template <typename Key, class Comparator>
     bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, SkipList::Node* n) const {
         // 判断key是否比节点n的key大
@@ -326,6 +370,21 @@ namespace leveldb {
         }
     }
 
+    template <typename Key, class Comparator>
+    void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key, Node* before, int level,
+                                                       Node** out_prev, Node** out_next) const {
+        while(true) {
+            Node* next = before->Next(level);
+            if(KeyIsAfterNode(key, next)) {
+                before = next;
+            } else {
+                *out_prev = before;
+                *out_next = next;
+                return;
+            }
+        }
+    }
+
     template <typename Key, class Comparator>
     SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena) 
         : compare_(cmp),
@@ -372,6 +431,47 @@ namespace leveldb {
         }
     }
 
+    template <typename Key, class Comparator>
+    void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+        int height = RandomHeightConcurrently();
+        // 通过CAS提升跳表高度，其他线程可能同时在提升，因此最终的max_height
+        // 不一定等于height，但一定不小于height
+        int max_height = GetMaxHeight();
+        while(height > max_height) {
+            if(max_height_.compare_exchange_weak(max_height, height)) {
+                max_height = height;
+                break;
+            }
+        }
+
+        Node* x = NewNodeConcurrently(key, height);
+
+        // 自顶向下找到key在每一层的前驱和后继节点，上层的前驱节点作为下层查找的起点；
+        // 高于原跳表高度的层会直接得到head_
+        Node* prev[kMaxHeight];
+        Node* next[kMaxHeight];
+        Node* before = head_;
+        for(int i = max_height - 1; i >= 0; i--) {
+            FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+            before = prev[i];
+        }
+        // 不允许在跳表中插入两个一样的key
+        assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+        // 自底向上逐层链接，保证读者看到上层指针时下层已经可见
+        for(int i = 0; i < height; i++) {
+            while(true) {
+                x->NoBarrier_SetNext(i, next[i]);
+                if(prev[i]->CASNext(i, next[i], x)) {
+                    break;
+                }
+                // 有其他线程在prev[i]之后插入了节点，节点不会被删除，
+                // 因此可以从prev[i]开始重新查找该层的插入位置
+                FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+            }
+        }
+    }
+
     template <typename Key, class Comparator>
     bool SkipList<Key, Comparator>::Contains(const Key& key) const {
         Node* x = FindGreaterOrEqual(key, nullptr);
@@ -31,11 +31,38 @@ namespace leveldb {
         cache->Release(h);
     }
 
+    // row cache中的value，保存在SSTable中找到的internal key与value，编码为：
+    //      internal_key_size: varint32
+    //      internal_key: char[internal_key_size]
+    //      value: char[value.size()]
+    static void DeleteRowCacheEntry(const Slice&, void* value) {
+        delete reinterpret_cast<std::string*>(value);
+    }
+
+    // 以kMaxSequenceNumber查找时，用于保存SSTable中user key的最新版本
+    struct RowCacheSaver {
+        const Comparator* ucmp;
+        Slice user_key;
+        bool found;
+        std::string entry;
+    };
+
+    static void SaveRowCacheEntry(void* arg, const Slice& ikey, const Slice& v, Cleanable*) {
+        RowCacheSaver* saver = reinterpret_cast<RowCacheSaver*>(arg);
+        // InternalGet返回的是第一个不小于查找目标的key，其user key可能与目标不同
+        if(saver->ucmp->Compare(ExtractUserKey(ikey), saver->user_key) == 0) {
+            saver->found = true;
+            PutLengthPrefixedSlice(&saver->entry, ikey);
+            saver->entry.append(v.data(), v.size());
+        }
+    }
+
     TableCache::TableCache(const std::string &dbname, const Options &options, int entries)
         : env_(options.env),
           dbname_(dbname),
           options_(options),
-          cache_(NewLRUCache(entries)){}
+          cache_(NewLRUCache(entries)),
+          row_cache_id_(options.row_cache != nullptr ? options.row_cache->NewId() : 0) {}
 
 
     TableCache::~TableCache() { delete cache_; }
@@ -74,6 +101,15 @@ namespace leveldb {
                 assert(table == nullptr);
                 delete file;
             } else {
+                if(options_.persistent_cache != nullptr && !persistent_cache_id_.empty()) {
+                    // 文件编号在DB中不会重复使用，再加上DB的唯一标识和文件大小，重启后仍能唯一确定该SSTable。
+                    // 删除并重新创建的同名DB的标识不同，不会读到之前的DB缓存的block
+                    std::string prefix = persistent_cache_id_;
+                    prefix.push_back('\0');
+                    PutFixed64(&prefix, file_number);
+                    PutFixed64(&prefix, file_size);
+                    table->SetPersistentCacheKeyPrefix(prefix);
+                }
                 // 作为键值对将table信息插入TableCache缓存，其中key是编码后的file_number, value是
                 // TableAndFile对象
                 TableAndFile* tf = new TableAndFile;
@@ -90,7 +126,7 @@ namespace leveldb {
     // 根据指定的文件(file_number标识的文件)返回一个迭代器，文件大小为file_size，单位为字节，如果
     // tableptr不是nullptr，则其指向返回的迭代器的底层table指针，返回的tableptr指针归缓存所有，不能被删除。
     Iterator* TableCache::NewIterator(const ReadOptions &options, uint64_t file_number, uint64_t file_size,
-                                      Table **tableptr) {
+                                      Table **tableptr, ScanTracker* scan_tracker) {
         if(tableptr != nullptr) {
             *tableptr = nullptr;
         }
@@ -106,7 +142,7 @@ namespace leveldb {
         // 先从缓存中取出Value（这里的Value是TableAndFile），然后从Value中取出table
         Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
         // 然后获取遍历table迭代器
-        Iterator* result = table->NewIterator(options);
+        Iterator* result = table->NewIterator(options, scan_tracker);
         // 注册清理函数
         result->RegisterCleanup(&UnrefEntry, cache_, handle);
 
@@ -118,9 +154,48 @@ namespace leveldb {
     }
 
     // 如果在指定的文件中根据internal key（也就是参数中的k）找到了一个对应项，则调用
-    // (*handle_result)(void*, const Slice&, const Slice&)。
+    // (*handle_result)(void*, const Slice&, const Slice&, Cleanable*)。
     Status TableCache::Get(const ReadOptions &options, uint64_t file_number, uint64_t file_size, const Slice &k,
-                           void *arg, void (*handle_result)(void *, const Slice &, const Slice &)) {
+                           void *arg, void (*handle_result)(void *, const Slice &, const Slice &, Cleanable *)) {
+        ParsedInternalKey parsed;
+        if(options_.row_cache != nullptr && ParseInternalKey(k, &parsed)) {
+            Cache* row_cache = options_.row_cache;
+            // row cache的key为：row_cache_id_ + file_number + user_key
+            std::string row_key;
+            PutFixed64(&row_key, row_cache_id_);
+            PutFixed64(&row_key, file_number);
+            row_key.append(parsed.user_key.data(), parsed.user_key.size());
+
+            Cache::Handle* row_handle = row_cache->Lookup(row_key);
+            if(row_handle == nullptr && options.fill_cache) {
+                Status s = FillRowCache(options, file_number, file_size, parsed.user_key, row_key, &row_handle);
+                if(!s.ok()) {
+                    return s;
+                }
+                // 该文件中没有任何版本的user key，当然也就没有对k可见的版本
+                if(row_handle == nullptr) {
+                    return s;
+                }
+            }
+
+            if(row_handle != nullptr) {
+                Slice entry(*reinterpret_cast<std::string*>(row_cache->Value(row_handle)));
+                Slice ikey;
+                ParsedInternalKey cached;
+                if(GetLengthPrefixedSlice(&entry, &ikey) && ParseInternalKey(ikey, &cached) &&
+                   cached.sequence <= parsed.sequence) {
+                    // 缓存的是文件中的最新版本，对k可见时就是k在该文件中能读到的版本。
+                    // value直接引用缓存中的数据，handle_result可以通过pinner持有缓存句柄
+                    Cleanable pinner;
+                    pinner.RegisterCleanup(&UnrefEntry, row_cache, row_handle);
+                    (*handle_result)(arg, ikey, entry, &pinner);
+                    return Status::OK();
+                }
+                // 快照早于缓存的版本，需要在SSTable中查找更早的版本
+                row_cache->Release(row_handle);
+            }
+            // fill_cache为false时未命中则直接查找SSTable
+        }
 
         Cache::Handle* handle = nullptr;
         // 找table
@@ -137,6 +212,59 @@ namespace leveldb {
         return s;
     }
 
+    Status TableCache::FillRowCache(const ReadOptions &options, uint64_t file_number, uint64_t file_size,
+                                    const Slice &user_key, const Slice &row_key, Cache::Handle **handle) {
+        *handle = nullptr;
+        Cache::Handle* table_handle = nullptr;
+        Status s = FindTable(file_number, file_size, &table_handle);
+        if(!s.ok()) {
+            return s;
+        }
+        // 以最大的sequence查找，得到该文件中user_key的最新版本，对之后任意快照的读取都可以复用
+        std::string seek_key;
+        AppendInternalKey(&seek_key, ParsedInternalKey(user_key, kMaxSequenceNumber, kValueTypeForSeek));
+        RowCacheSaver saver;
+        saver.ucmp = reinterpret_cast<const InternalKeyComparator*>(options_.comparator)->user_comparator();
+        saver.user_key = user_key;
+        saver.found = false;
+        Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(table_handle))->table;
+        s = t->InternalGet(options, seek_key, &saver, &SaveRowCacheEntry);
+        cache_->Release(table_handle);
+
+        if(s.ok() && saver.found) {
+            std::string* entry = new std::string(std::move(saver.entry));
+            const size_t charge = row_key.size() + entry->size();
+            *handle = options_.row_cache->Insert(row_key, entry, charge, &DeleteRowCacheEntry);
+        }
+        return s;
+    }
+
+    Status TableCache::MultiGet(const ReadOptions &options, uint64_t file_number, uint64_t file_size,
+                                const Slice *keys, int n, void *arg,
+                                void (*handle_result)(void *, int, const Slice &, const Slice &)) {
+        Cache::Handle* handle = nullptr;
+        Status s = FindTable(file_number, file_size, &handle);
+        if(s.ok()) {
+            Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+            s = t->InternalMultiGet(options, keys, n, arg, handle_result);
+            cache_->Release(handle);
+        }
+
+        return s;
+    }
+
+    bool TableCache::PrefixMayMatch(const ReadOptions &options, uint64_t file_number, uint64_t file_size,
+                                    const Slice &target) {
+        Cache::Handle* handle = nullptr;
+        bool may_match = true;
+        if(FindTable(file_number, file_size, &handle).ok()) {
+            Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+            may_match = t->PrefixMayMatch(options, target);
+            cache_->Release(handle);
+        }
+        return may_match;
+    }
+
     void TableCache::Evict(uint64_t file_number) {
         // 根据file_number构造key
         char buf[sizeof(file_number)];
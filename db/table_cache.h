@@ -16,6 +16,7 @@
 namespace leveldb {
 
     class Env;
+    class ScanTracker;
 
     class TableCache {
     public:
@@ -24,20 +25,42 @@ namespace leveldb {
 
         // 根据指定的文件(file_number标识的文件)返回一个迭代器，文件大小为file_size，单位为字节，如果
         // tableptr不是nullptr，则其指向返回的迭代器的底层table指针，返回的tableptr指针归缓存所有，不能被删除。
-        Iterator* NewIterator(const ReadOptions& options, uint64_t file_number, uint64_t file_size, Table** tableptr = nullptr);
+        // scan_tracker不为nullptr时，读取的data block计入其中，见Options::scan_fill_cache_limit
+        Iterator* NewIterator(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                              Table** tableptr = nullptr, ScanTracker* scan_tracker = nullptr);
 
         // 如果在指定的文件中根据internal key（也就是参数中的k）找到了一个对应项，则调用
-        // (*handle_result)(void*, const Slice&, const Slice&)。
+        // (*handle_result)(void*, const Slice&, const Slice&, Cleanable*)，最后一个参数的含义见Table::InternalGet。
+        // 设置了Options::row_cache时先在其中查找，k的sequence不小于缓存的版本时直接使用缓存的结果
         Status Get(const ReadOptions& options, uint64_t file_number, uint64_t file_size, const Slice& k, void * arg,
-                   void (*handle_result)(void*, const Slice&, const Slice&));
+                   void (*handle_result)(void*, const Slice&, const Slice&, Cleanable*));
+
+        // 在指定的文件中批量查找keys[0, n-1]（按internal key升序排列），对找到的第i个key调用
+        // (*handle_result)(arg, i, k, v)。整个批次只查找一次table缓存。
+        Status MultiGet(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                        const Slice* keys, int n, void* arg,
+                        void (*handle_result)(void*, int, const Slice&, const Slice&));
+
+        // 根据指定文件的filter判断其中是否可能存在与target（internal key）前缀相同且不小于target的key，
+        // 见Table::PrefixMayMatch。打开文件出错时返回true，错误留给之后的读取返回
+        bool PrefixMayMatch(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                            const Slice& target);
 
         // 根据file_number删除缓存项
         void Evict(uint64_t file_number);
 
+        // 设置数据库的唯一标识，用于构造SSTable在Options::persistent_cache中的key前缀。
+        // 需要在读取任何SSTable之前调用，未设置时不使用persistent_cache
+        void SetPersistentCacheId(const std::string& id) { persistent_cache_id_ = id; }
+
     private:
         // 查找table，先在缓存中查找，缓存没有则再去打开table文件，并加载到缓存，并保存
         // 缓存节点到Handle
         Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+        // 在指定的文件中查找user_key的最新版本，找到时将其放入row cache并通过*handle返回，
+        // 文件中不存在该user key时*handle为nullptr
+        Status FillRowCache(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                            const Slice& user_key, const Slice& row_key, Cache::Handle** handle);
         // 用于文件操作
         Env* const env_;
         // 数据库的名称
@@ -47,6 +70,10 @@ namespace leveldb {
         // 使用的缓存对象，TableCache使用了一个ShardedLRUCache,
         // LRUCache缓存的也是KV映射，其中Key是文件编号file_number, Value是TableAndFile
         Cache* cache_;
+        // 在Options::row_cache中使用的key前缀，row cache可能被多个DB共享
+        const uint64_t row_cache_id_;
+        // 数据库的唯一标识，见SetPersistentCacheId()
+        std::string persistent_cache_id_;
     };
 
 } // end namespace leveldb
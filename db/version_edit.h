@@ -18,7 +18,7 @@ namespace leveldb {
 
     // 用于描述一个SSTable的信息，记录了SSTable元数据
    struct FileMetaData {
-       FileMetaData() : refs(0), allowed_seeks(1<<30), file_size(0) {}
+       FileMetaData() : refs(0), allowed_seeks(1<<30), file_size(0), being_compacted(false) {}
 
        int refs;
        // 是否允许遍历，仅当Compaction时不允许遍历
@@ -31,6 +31,8 @@ namespace leveldb {
        InternalKey smallest;
        // SSTable中的最大key
        InternalKey largest;
+       // 是否正在作为某个compaction的输入，受DB的mutex保护
+       bool being_compacted;
    };
 
    // VersionEdit记录了Version之间的变化，相当于Version的增量，
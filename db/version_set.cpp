@@ -12,6 +12,7 @@
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/pinnable_slice.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
@@ -244,27 +245,156 @@ namespace leveldb {
         }
     }
 
+    // 读取一层的文件并统计扫描的data block时GetTrackedFileIterator的参数
+    struct TrackedFileIteratorArg {
+        TableCache* table_cache;
+        ScanTracker* scan_tracker;
+    };
+
+    static void DeleteTrackedFileIteratorArg(void* arg, void*) {
+        delete reinterpret_cast<TrackedFileIteratorArg*>(arg);
+    }
+
+    // 与GetFileIterator相同，文件的迭代器读取的data block计入arg->scan_tracker
+    static Iterator* GetTrackedFileIterator(void* arg, const ReadOptions& options,
+                                            const Slice& file_value) {
+        TrackedFileIteratorArg* tracked = reinterpret_cast<TrackedFileIteratorArg*>(arg);
+        if(file_value.size() != 16) {
+            return NewErrorIterator(Status::Corruption("FileReader invoked with unexpected value"));
+        } else {
+            return tracked->table_cache->NewIterator(options,
+                                                     DecodeFixed64(file_value.data()),
+                                                     DecodeFixed64(file_value.data() + 8),
+                                                     nullptr, tracked->scan_tracker);
+        }
+    }
+
+    // ReadOptions::prefix_same_as_start时包装level0的一个文件或level > 0的一整层的迭代器。
+    // Seek()时先通过target所在文件的filter判断其中是否可能存在与target前缀相同的key，
+    // 不存在时不读取任何data block，直接使迭代器失效。
+    // 具有相同前缀的key是连续的，target所在文件中不存在该前缀时之后的文件中也不会存在，
+    // 因此失效的迭代器不会漏掉与target前缀相同的key，但Seek()之后不能再反向移动
+    class Version::PrefixFilterIterator : public Iterator {
+    public:
+        // file不为nullptr时iter遍历的是该文件，否则iter遍历的是files中的所有文件
+        PrefixFilterIterator(TableCache* table_cache, const InternalKeyComparator& icmp,
+                             const ReadOptions& options, Iterator* iter,
+                             const FileMetaData* file, const std::vector<FileMetaData*>* files)
+             : table_cache_(table_cache), icmp_(icmp), options_(options), iter_(iter),
+               file_(file), files_(files), filtered_(false) {}
+
+        ~PrefixFilterIterator() override { delete iter_; }
+
+        bool Valid() const override {
+            return !filtered_ && iter_->Valid();
+        }
+
+        void Seek(const Slice& target) override {
+            const FileMetaData* f = file_;
+            if(f == nullptr) {
+                const int index = FindFile(icmp_, *files_, target);
+                if(index < static_cast<int>(files_->size())) {
+                    f = (*files_)[index];
+                }
+            }
+            filtered_ = (f != nullptr &&
+                         !table_cache_->PrefixMayMatch(options_, f->number, f->file_size, target));
+            if(!filtered_) {
+                iter_->Seek(target);
+            }
+        }
+
+        void SeekToFirst() override {
+            filtered_ = false;
+            iter_->SeekToFirst();
+        }
+
+        void SeekToLast() override {
+            filtered_ = false;
+            iter_->SeekToLast();
+        }
+
+        void Next() override {
+            assert(Valid());
+            iter_->Next();
+        }
+
+        void Prev() override {
+            assert(Valid());
+            iter_->Prev();
+        }
+
+        Slice key() const override {
+            assert(Valid());
+            return iter_->key();
+        }
+
+        Slice value() const override {
+            assert(Valid());
+            return iter_->value();
+        }
+
+        Status status() const override {
+            return iter_->status();
+        }
+
+    private:
+        TableCache* const table_cache_;
+        const InternalKeyComparator icmp_;
+        const ReadOptions options_;
+        Iterator* const iter_;
+        const FileMetaData* const file_;
+        const std::vector<FileMetaData*>* const files_;
+        // 最近一次Seek()是否被filter排除
+        bool filtered_;
+    };
+
     // 联合两个迭代器，返回一个双层迭代器
-    Iterator* Version::NewConcatenatingIterator(const ReadOptions& options, int level) const {
+    Iterator* Version::NewConcatenatingIterator(const ReadOptions& options, int level,
+                                                ScanTracker* scan_tracker) const {
         // 返回一个双层迭代器
         // 第一个迭代器定位到索引，第二个迭代器根据第一个迭代器的结果定位具体的信息
-        return NewTwoLevelIterator(
-                new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-                vset_->table_cache_, options);
+        if(scan_tracker == nullptr) {
+            return NewTwoLevelIterator(
+                    new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
+                    vset_->table_cache_, options);
+        }
+        // 文件之间切换时不会重新开始统计，跨越多个文件的扫描同样会被识别
+        TrackedFileIteratorArg* arg = new TrackedFileIteratorArg{vset_->table_cache_, scan_tracker};
+        Iterator* iter = NewTwoLevelIterator(
+                new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetTrackedFileIterator,
+                arg, options);
+        iter->RegisterCleanup(&DeleteTrackedFileIteratorArg, arg, nullptr);
+        return iter;
     }
 
     // 构造读取整个DB的iterators，并添加到*iters
-    void Version::AddIterators(const ReadOptions& options, std::vector<Iterator *> *iters) {
+    void Version::AddIterators(const ReadOptions& options, std::vector<Iterator *> *iters,
+                               ScanTracker* scan_tracker) {
+        // 前缀迭代器在Seek()时通过filter跳过不包含目标前缀的文件
+        const bool prefix_filter = options.prefix_same_as_start &&
+                                   vset_->options_->prefix_extractor != nullptr &&
+                                   vset_->options_->filter_policy != nullptr;
         // 合并左右的level0的文件，因为它们之间可能有重叠
         for(size_t i = 0; i < files_[0].size(); i++) {
-            iters->push_back(vset_->table_cache_->NewIterator(
-                    options, files_[0][i]->number, files_[0][i]->file_size));
+            Iterator* iter = vset_->table_cache_->NewIterator(
+                    options, files_[0][i]->number, files_[0][i]->file_size, nullptr, scan_tracker);
+            if(prefix_filter) {
+                iter = new PrefixFilterIterator(vset_->table_cache_, vset_->icmp_, options, iter,
+                                                files_[0][i], nullptr);
+            }
+            iters->push_back(iter);
         }
 
         // 对于level > 0 ,使用一个连接的双层迭代器，来顺序遍历level中的不相交文件
         for(int level = 1; level < config::kNumLevels; level++) {
             if(!files_[level].empty()) {
-                iters->push_back(NewConcatenatingIterator(options, level));
+                Iterator* iter = NewConcatenatingIterator(options, level, scan_tracker);
+                if(prefix_filter) {
+                    iter = new PrefixFilterIterator(vset_->table_cache_, vset_->icmp_, options, iter,
+                                                    nullptr, &files_[level]);
+                }
+                iters->push_back(iter);
             }
         }
     }
@@ -282,13 +412,15 @@ namespace leveldb {
             SaveState state;
             const Comparator* ucmp;
             Slice user_key;
+            // value与pinnable_value只有一个不为nullptr
             std::string* value;
+            PinnableSlice* pinnable_value;
         };
 
     } // end namespace
 
-    // 将查找结果保存在v中
-    static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
+    // 将查找结果v保存到saver中，若value_pinner不为nullptr则可以通过它pin住v而不拷贝
+    static void SaveValue(void* arg, const Slice& ikey, const Slice& v, Cleanable* value_pinner) {
         Saver* s = reinterpret_cast<Saver*>(arg);
         ParsedInternalKey parsed_key;
         if(!ParseInternalKey(ikey, &parsed_key)) {
@@ -299,7 +431,13 @@ namespace leveldb {
                 // 检查类型
                 s->state = (parsed_key.type == kTypeValue) ? kFound : kDelete;
                 if(s->state == kFound) {
-                    s->value->assign(v.data(), v.size());
+                    if(s->pinnable_value == nullptr) {
+                        s->value->assign(v.data(), v.size());
+                    } else if(value_pinner != nullptr) {
+                        s->pinnable_value->PinSlice(v, value_pinner);
+                    } else {
+                        s->pinnable_value->PinSelf(v);
+                    }
                 }
             }
         }
@@ -370,7 +508,7 @@ namespace leveldb {
 
     // 在磁盘上执行key查找，value保存查找结果，stats保存第一次进行无效查询的文件和其所在level
     Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                        std::string* value, GetStats* stats) {
+                        PinnableSlice* value, GetStats* stats) {
         stats->seek_file = nullptr;
         stats->seek_file_level = -1;
 
@@ -451,7 +589,8 @@ namespace leveldb {
         state.saver.state = kNotFound;
         state.saver.ucmp = vset_->icmp_.user_comparator();
         state.saver.user_key = k.user_key();
-        state.saver.value = value;
+        state.saver.value = nullptr;
+        state.saver.pinnable_value = value;
 
         // 1. 找key range覆盖指定key的文件，也即找到可能包含此key的文件;
         // 2. 找到相关文件后调用Match方法在该文件中进一步查找。
@@ -460,6 +599,156 @@ namespace leveldb {
         return state.found ? state.s : Status::NotFound(Slice());
     }
 
+    namespace {
+        // Version::MultiGet中每个key的查找状态
+        struct MultiGetKeyState {
+            Saver saver;
+            // 是否已经得到了最终结果
+            bool done;
+            FileMetaData* last_file_read;
+            int last_file_read_level;
+        };
+
+        // 一次在单个文件中批量查找的key，indexes[i]为第i个key在所有key中的下标
+        struct MultiGetBatch {
+            std::vector<MultiGetKeyState>* states;
+            const std::vector<size_t>* indexes;
+        };
+    } // end namespace
+
+    // 来自TableCache::MultiGet()的回调
+    static void SaveMultiValue(void* arg, int index, const Slice& ikey, const Slice& v) {
+        MultiGetBatch* batch = reinterpret_cast<MultiGetBatch*>(arg);
+        // 同一个data block可能被批次中的多个key引用，这里总是拷贝value
+        SaveValue(&(*batch->states)[(*batch->indexes)[index]].saver, ikey, v, nullptr);
+    }
+
+    void Version::MultiGet(const ReadOptions &options, const std::vector<const LookupKey*>& keys,
+                           const std::vector<std::string*>& values, const std::vector<Status*>& statuses,
+                           GetStats *stats) {
+        stats->seek_file = nullptr;
+        stats->seek_file_level = -1;
+
+        const Comparator* ucmp = vset_->icmp_.user_comparator();
+        const size_t n = keys.size();
+        std::vector<MultiGetKeyState> states(n);
+        for(size_t i = 0; i < n; i++) {
+            states[i].saver.state = kNotFound;
+            states[i].saver.ucmp = ucmp;
+            states[i].saver.user_key = keys[i]->user_key();
+            states[i].saver.value = values[i];
+            states[i].saver.pinnable_value = nullptr;
+            states[i].done = false;
+            states[i].last_file_read = nullptr;
+            states[i].last_file_read_level = -1;
+        }
+
+        // 在文件f中查找indexes中的各个key，并根据结果更新各个key的状态
+        std::vector<Slice> batch_keys;
+        auto read_file = [&](int level, FileMetaData* f, const std::vector<size_t>& indexes) {
+            batch_keys.clear();
+            for(size_t index : indexes) {
+                MultiGetKeyState* state = &states[index];
+                // 与Get相同，一个key查找了不只一个文件时记录第一个文件
+                if(stats->seek_file == nullptr && state->last_file_read != nullptr) {
+                    stats->seek_file = state->last_file_read;
+                    stats->seek_file_level = state->last_file_read_level;
+                }
+                state->last_file_read = f;
+                state->last_file_read_level = level;
+                batch_keys.push_back(keys[index]->internal_key());
+            }
+            MultiGetBatch batch;
+            batch.states = &states;
+            batch.indexes = &indexes;
+            Status s = vset_->table_cache_->MultiGet(options, f->number, f->file_size,
+                                                     batch_keys.data(), static_cast<int>(batch_keys.size()),
+                                                     &batch, SaveMultiValue);
+            for(size_t index : indexes) {
+                MultiGetKeyState* state = &states[index];
+                if(!s.ok()) {
+                    *statuses[index] = s;
+                    state->done = true;
+                    continue;
+                }
+                switch (state->saver.state) {
+                    case kNotFound:
+                        // 继续去其他文件查找
+                        break;
+                    case kFound:
+                        *statuses[index] = Status::OK();
+                        state->done = true;
+                        break;
+                    case kDelete:
+                        *statuses[index] = Status::NotFound(Slice());
+                        state->done = true;
+                        break;
+                    case kCorrupt:
+                        *statuses[index] = Status::Corruption("corrupted key for ", state->saver.user_key);
+                        state->done = true;
+                        break;
+                }
+            }
+        };
+
+        std::vector<size_t> indexes;
+        // 1. level0中的文件可能相互重叠，按照从新到旧的顺序依次查找，
+        //    每个文件中一起查找key range覆盖的所有还未得到结果的key
+        std::vector<FileMetaData*> tmp(files_[0]);
+        std::sort(tmp.begin(), tmp.end(), NewestFirst);
+        for(FileMetaData* f : tmp) {
+            indexes.clear();
+            for(size_t i = 0; i < n; i++) {
+                if(!states[i].done &&
+                   ucmp->Compare(states[i].saver.user_key, f->smallest.user_key()) >= 0 &&
+                   ucmp->Compare(states[i].saver.user_key, f->largest.user_key()) <= 0) {
+                    indexes.push_back(i);
+                }
+            }
+            if(!indexes.empty()) {
+                read_file(0, f, indexes);
+            }
+        }
+
+        // 2. 其余level中的文件互不重叠，key有序，因此落在同一个文件中的key是连续的
+        for(int level = 1; level < config::kNumLevels; level++) {
+            const size_t num_files = files_[level].size();
+            if(num_files == 0) continue;
+            FileMetaData* batch_file = nullptr;
+            indexes.clear();
+            for(size_t i = 0; i < n; i++) {
+                if(states[i].done) continue;
+                uint32_t index = FindFile(vset_->icmp_, files_[level], keys[i]->internal_key());
+                if(index >= num_files) {
+                    // 剩余的key都大于该level中的最大key
+                    break;
+                }
+                FileMetaData* f = files_[level][index];
+                if(ucmp->Compare(states[i].saver.user_key, f->smallest.user_key()) < 0) {
+                    // 该file的key range不覆盖此key
+                    continue;
+                }
+                if(f != batch_file) {
+                    if(!indexes.empty()) {
+                        read_file(level, batch_file, indexes);
+                    }
+                    indexes.clear();
+                    batch_file = f;
+                }
+                indexes.push_back(i);
+            }
+            if(!indexes.empty()) {
+                read_file(level, batch_file, indexes);
+            }
+        }
+
+        for(size_t i = 0; i < n; i++) {
+            if(!states[i].done) {
+                *statuses[i] = Status::NotFound(Slice());
+            }
+        }
+    }
+
     // 更新一个文件的统计信息，也即其允许seek的次数
     bool Version::UpdateStats(const GetStats &stats) {
         FileMetaData* f = stats.seek_file;
@@ -857,6 +1146,13 @@ namespace leveldb {
     // 在current version上应用指定的VersionEdit，生成新的MANIFEST信息，
     // 并保存到磁盘上用作current version。
     Status VersionSet::LogAndApply(VersionEdit *edit, port::Mutex *mu) {
+        // 写manifest时会释放锁，排队等待前面的线程完成，使各个edit都基于最新的current_
+        port::CondVar cv(mu);
+        manifest_writers_.push_back(&cv);
+        while(manifest_writers_.front() != &cv) {
+            cv.Wait();
+        }
+
         if(edit->has_log_number_) {
             assert(edit->log_number_ >= log_number_);
             assert(edit->log_number_ < next_file_number_);
@@ -944,6 +1240,10 @@ namespace leveldb {
             }
         }
 
+        manifest_writers_.pop_front();
+        if(!manifest_writers_.empty()) {
+            manifest_writers_.front()->Signal();
+        }
         return s;
     }
 
@@ -1073,7 +1373,7 @@ namespace leveldb {
             AppendVersion(v);
             manifest_file_number_ = next_file;
             next_file_number_ = next_file + 1;
-            last_sequence_ = last_sequence_;
+            last_sequence_.store(last_sequence, std::memory_order_release);
             log_number_ = log_number;
             prev_log_number_ = prev_log_number;
 
@@ -1137,6 +1437,8 @@ namespace leveldb {
         // 计算下一次执行compaction的最佳level
         int best_level = -1;
         double best_score = -1;
+        // L0达到compaction条件时其全部数据都需要被compact，其余level只计算超出容量上限的部分
+        uint64_t debt = 0;
         // 找到得分最高的level，得分最高的便是最佳compaction level
         for(int level = 0; level < config::kNumLevels - 1; level++) {
             double score;
@@ -1148,11 +1450,19 @@ namespace leveldb {
             if(level == 0) {
                 score = v->files_[level].size() /
                         static_cast<double>(config::kL0_CompactionTrigger);
+                if(v->files_[level].size() >= static_cast<size_t>(config::kL0_CompactionTrigger)) {
+                    debt += TotalFileSize(v->files_[level]);
+                }
             } else {
                 // 计算(current size) / (size limit)
                 const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-                score = static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+                const double max_bytes = MaxBytesForLevel(options_, level);
+                score = static_cast<double>(level_bytes) / max_bytes;
+                if(level_bytes > max_bytes) {
+                    debt += level_bytes - static_cast<uint64_t>(max_bytes);
+                }
             }
+            v->compaction_scores_[level] = score;
 
             if( score > best_score) {
                 best_level = level;
@@ -1162,6 +1472,7 @@ namespace leveldb {
 
         v->compaction_level_ = best_level;
         v->compaction_score_ = best_score;
+        v->compaction_debt_ = debt;
     }
 
     // 将当前VersionSet的current_指针指向的Version作为快照写到磁盘的MANIFEST文件
@@ -1375,52 +1686,64 @@ namespace leveldb {
 
     // 根据要执行compact的level选择具体的文件，然后构造成Compaction对象并返回
     Compaction* VersionSet::PickCompaction() {
-        Compaction* c;
-        int level;
-
         // 触发compaction的两种情况：
         //  1. size compaction：一个level中的数据超过阈值；
         //  2. seek compaction：一个level中某个文件的无效查询次数过多，例如：要查询某个key，但是在查询
         //     该到key之前总会额外查询某个文件，造成非必要查询。
         // 而且leveldb更偏爱由大小超限所引起的压缩、
+        //
+        // 可能已有其他compaction正在执行，所以需要跳过与它们冲突的level和文件
+        Compaction* c = nullptr;
 
-        const bool size_compaction = (current_->compaction_score_ >= 1); // 大小超限引起压缩
-        const bool seek_compaction = (current_->file_to_compact_ != nullptr); // 无效查询引起压缩
-
-        // size compaction的优先级更高
-        if(size_compaction) {
-            // 要执行compact的level
-            level = current_->compaction_level_;
-            assert(level >= 0);
-            assert(level + 1 < config::kNumLevels);
-            // 构造Compaction对象，其中包含了要执行compact的level和相关文件
-            c = new Compaction(options_, level);
-
+        // size compaction的优先级更高，按得分从高到低依次尝试各个得分超过1的level
+        std::vector<int> levels;
+        for(int level = 0; level < config::kNumLevels - 1; level++) {
+            if(current_->compaction_scores_[level] >= 1) {
+                levels.push_back(level);
+            }
+        }
+        std::sort(levels.begin(), levels.end(), [this](int a, int b) {
+            return current_->compaction_scores_[a] > current_->compaction_scores_[b];
+        });
+        for(size_t i = 0; c == nullptr && i < levels.size(); i++) {
+            const int level = levels[i];
+            const std::vector<FileMetaData*>& files = current_->files_[level];
             // 选择level的压缩点后的第一个文件, 此文件便是具体要执行compact的文件，
-            // 将其存入Compaction对象
-            for(size_t i = 0; i < current_->files_[level].size(); i++) {
-                FileMetaData* f = current_->files_[level][i];
-                if(compact_pointer_[level].empty() ||
-                   icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) >= 0) {
-                    // 找到要执行compaction的文件后将其存入Compaction对象
-                    c->inputs_[0].push_back(f);
+            // 没有压缩点则从level的第一个文件开始；该文件冲突时依次尝试后面的文件
+            size_t start = 0;
+            while(start < files.size() && !compact_pointer_[level].empty() &&
+                  icmp_.Compare(files[start]->largest.Encode(), compact_pointer_[level]) < 0) {
+                start++;
+            }
+            for(size_t j = 0; c == nullptr && j < files.size(); j++) {
+                c = SetupCompaction(level, files[(start + j) % files.size()]);
+                if(level == 0) {
+                    // level-0的文件之间有重叠，只尝试压缩点处的文件
                     break;
                 }
             }
-            // 没有压缩点，则选择level的第一个文件
-            if(c->inputs_[0].empty()) {
-                c->inputs_[0].push_back(current_->files_[level][0]);
-            }
+        }
 
-        } else if(seek_compaction) {
-            // 若是无效查询过多引起的压缩，则直接将该文件存入Compaction对象即可
-            level = current_->file_to_compact_level_;
-            c = new Compaction(options_, level);
-            c->inputs_[0].push_back(current_->file_to_compact_);
-        } else {
-            return nullptr;
+        if(c == nullptr && current_->file_to_compact_ != nullptr) {
+            // 若是无效查询过多引起的压缩，则直接将该文件作为起始输入
+            c = SetupCompaction(current_->file_to_compact_level_, current_->file_to_compact_);
         }
 
+        if(c != nullptr) {
+            RegisterCompaction(c);
+        }
+        return c;
+    }
+
+    Compaction* VersionSet::SetupCompaction(int level, FileMetaData *f) {
+        assert(level >= 0);
+        assert(level + 1 < config::kNumLevels);
+        if(f->being_compacted) {
+            return nullptr;
+        }
+        // 构造Compaction对象，其中包含了要执行compact的level和相关文件
+        Compaction* c = new Compaction(options_, level);
+        c->inputs_[0].push_back(f);
         c->input_version_ = current_;
         c->input_version_->Ref();
 
@@ -1436,9 +1759,71 @@ namespace leveldb {
         // 根据选择好的要执行压缩的第一个文件，匹配其他需要一块执行compaction的文件
         SetupOtherInputs(c);
 
+        if(ConflictsWithRunningCompactions(c)) {
+            delete c;
+            return nullptr;
+        }
         return c;
     }
 
+    bool VersionSet::ConflictsWithRunningCompactions(Compaction *c) {
+        for(int which = 0; which < 2; which++) {
+            for(FileMetaData* f : c->inputs_[which]) {
+                if(f->being_compacted) {
+                    return true;
+                }
+            }
+        }
+
+        const Comparator* user_cmp = icmp_.user_comparator();
+        InternalKey smallest, largest;
+        GetRange2(c->inputs_[0], c->inputs_[1], &smallest, &largest);
+        for(Compaction* running : running_compactions_) {
+            // level-0的文件之间有重叠，同一时刻只允许一个level-0的compaction
+            if(c->level() == 0 && running->level() == 0) {
+                return true;
+            }
+            // 输出到同一level的两个compaction的key range不能重叠，否则输出文件会重叠
+            if(running->level() == c->level()) {
+                InternalKey running_smallest, running_largest;
+                GetRange2(running->inputs_[0], running->inputs_[1],
+                          &running_smallest, &running_largest);
+                if(user_cmp->Compare(smallest.user_key(), running_largest.user_key()) <= 0 &&
+                   user_cmp->Compare(running_smallest.user_key(), largest.user_key()) <= 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void VersionSet::RegisterCompaction(Compaction *c) {
+        for(int which = 0; which < 2; which++) {
+            for(FileMetaData* f : c->inputs_[which]) {
+                assert(!f->being_compacted);
+                f->being_compacted = true;
+            }
+        }
+        running_compactions_.push_back(c);
+
+        // 本次compact的最大key即为level的压缩点
+        InternalKey smallest, largest;
+        GetRange(c->inputs_[0], &smallest, &largest);
+        compact_pointer_[c->level()] = largest.Encode().ToString();
+        c->edit_.SetCompactPointer(c->level(), largest);
+    }
+
+    void VersionSet::ReleaseCompaction(Compaction *c) {
+        auto iter = std::find(running_compactions_.begin(), running_compactions_.end(), c);
+        assert(iter != running_compactions_.end());
+        running_compactions_.erase(iter);
+        for(int which = 0; which < 2; which++) {
+            for(FileMetaData* f : c->inputs_[which]) {
+                f->being_compacted = false;
+            }
+        }
+    }
+
     // 查找files中的最大key，将其存在*largest_key中，若files不为空
     // 的话则返回true。
     bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1572,9 +1957,7 @@ namespace leveldb {
         if(level + 2 < config::kNumLevels) {
             current_->GetOverlappingInputs(level + 2, &all_start, &all_limit, &c->grandparents_);
         }
-        // 本次compact的最大key即为level的压缩点
-        compact_pointer_[level] = largest.Encode().ToString();
-        c->edit_.SetCompactPointer(level, largest);
+        // 压缩点在compaction被确定执行时由RegisterCompaction()设置
     }
 
     // 构造并返回一个在指定level上对范围[begin, end]执行compaction的compaction对象。
@@ -1605,6 +1988,9 @@ namespace leveldb {
         c->input_version_->Ref();
         c->inputs_[0] = inputs;
         SetupOtherInputs(c);
+        // 手动compaction只会在没有其他compaction执行时进行，所以不会冲突
+        assert(!ConflictsWithRunningCompactions(c));
+        RegisterCompaction(c);
         return c;
     }
 
@@ -1692,6 +2078,16 @@ namespace leveldb {
         }
     }
 
+    Compaction* Compaction::NewSubcompaction() const {
+        Compaction* c = new Compaction(input_version_->vset_->options_, level_);
+        c->input_version_ = input_version_;
+        c->input_version_->Ref();
+        c->inputs_[0] = inputs_[0];
+        c->inputs_[1] = inputs_[1];
+        c->grandparents_ = grandparents_;
+        return c;
+    }
+
 
 } // end namespace leveldb
 
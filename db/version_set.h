@@ -5,6 +5,8 @@
 #ifndef LLEVELDB_VERSION_SET_H
 #define LLEVELDB_VERSION_SET_H
 
+#include <atomic>
+#include <deque>
 #include <map>
 #include <set>
 #include <vector>
@@ -35,6 +37,8 @@ namespace leveldb {
     class Compaction;
     class Iterator;
     class MemTable;
+    class PinnableSlice;
+    class ScanTracker;
     class TableBuilder;
     class TableCache;
     class Version;
@@ -80,11 +84,21 @@ namespace leveldb {
          * 向iters*中添加一系列iterator，在将它们合并时会生成当前Version的内容
          * @param iters
          */
-        void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
+        // scan_tracker不为nullptr时，各个SSTable的迭代器读取的data block计入其中
+        void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters,
+                          ScanTracker* scan_tracker = nullptr);
 
-        Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
+        // 在SSTables中查找key，value位于block cache中的data block时*val直接pin住该block，否则拷贝到*val中
+        Status Get(const ReadOptions&, const LookupKey& key, PinnableSlice* val,
                    GetStats* stats);
 
+        // 批量查找keys中的各个key，keys需按照user key升序排列，values[i]、statuses[i]保存keys[i]的结果。
+        // 各个key按照与Get相同的顺序查找各个文件，落在同一个文件中的key一起在该文件中查找。
+        // stats只记录第一个产生无效查询的文件。
+        void MultiGet(const ReadOptions&, const std::vector<const LookupKey*>& keys,
+                      const std::vector<std::string*>& values, const std::vector<Status*>& statuses,
+                      GetStats* stats);
+
         /**
          * 向当前的stat中添加"stats"
          * @param stats
@@ -155,6 +169,7 @@ namespace leveldb {
         friend class VersionSet;
 
         class LevelFileNumIterator;
+        class PrefixFilterIterator;
 
         explicit Version(VersionSet* vset)
             : vset_(vset),
@@ -164,14 +179,20 @@ namespace leveldb {
               file_to_compact_(nullptr),
               file_to_compact_level_(-1),
               compaction_score_(-1),
-              compaction_level_(-1){}
+              compaction_level_(-1),
+              compaction_debt_(0) {
+            for(int level = 0; level < config::kNumLevels - 1; level++) {
+                compaction_scores_[level] = -1;
+            }
+        }
 
         Version(const Version&) = delete;
         Version& operator=(const Version&) = delete;
 
         ~Version();
 
-        Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
+        Iterator* NewConcatenatingIterator(const ReadOptions&, int level,
+                                           ScanTracker* scan_tracker = nullptr) const;
 
         /**
          * 查找覆盖user_key的SSTable文件，然后对查找到的SSTable文件调用函数func(arg, level, f)
@@ -205,6 +226,10 @@ namespace leveldb {
         double compaction_score_;
         // 下一次要进行compact的level
         int compaction_level_;
+        // 每个level的得分，可同时执行多个compaction时按得分从高到低依次尝试各个level
+        double compaction_scores_[config::kNumLevels - 1];
+        // 估算的compaction负债，即需要被compact的字节数，用于控制写入速度
+        uint64_t compaction_debt_;
     };
 
     class VersionSet {
@@ -250,13 +275,16 @@ namespace leveldb {
         // 返回指定level的所有文件的大小之和
         int64_t NumLevelBytes(int level) const;
 
-        // 返回最后一个seq
-        uint64_t LastSequence() const { return last_sequence_; }
+        // 返回当前Version估算的compaction负债，单位为字节
+        uint64_t EstimatedCompactionDebt() const { return current_->compaction_debt_; }
+
+        // 返回最后一个seq，读操作不持有锁也可以调用
+        uint64_t LastSequence() const { return last_sequence_.load(std::memory_order_acquire); }
 
         // 设置最后一个seq 为 s
         void SetLastSequence(uint64_t s) {
-            assert(s >= last_sequence_);
-            last_sequence_ = s;
+            assert(s >= last_sequence_.load(std::memory_order_relaxed));
+            last_sequence_.store(s, std::memory_order_release);
         }
 
         // 标记指定的文件编号为used
@@ -273,8 +301,19 @@ namespace leveldb {
          * 如果不需要进行compaction，则返回nullptr，
          * 否则返回指向描述此次compaction操作的堆分配对象指针。
          */
+        // 可同时执行多个compaction，返回的compaction不会与正在执行的compaction
+        // 有重叠的输入文件或输出范围，若找不到这样的compaction也返回nullptr。
         Compaction* PickCompaction();
 
+        // compaction执行完毕（无论成功与否）后调用，取消对其输入文件的标记，
+        // 必须在c->ReleaseInputs()之前调用
+        void ReleaseCompaction(Compaction* c);
+
+        // 返回正在执行的compaction的数量
+        int NumRunningCompactions() const {
+            return static_cast<int>(running_compactions_.size());
+        }
+
         /**
          * 返回一个在指定level上对范围[begin, end]执行compaction的compaction对象。
          * @param level
@@ -327,6 +366,15 @@ namespace leveldb {
 
         void SetupOtherInputs(Compaction* c);
 
+        // 以level中的文件f作为起始输入构造一个compaction，若与正在执行的compaction冲突则返回nullptr
+        Compaction* SetupCompaction(int level, FileMetaData* f);
+
+        // c的输入文件是否正在被其他compaction使用，或c与输出到同一level的其他compaction的key range有重叠
+        bool ConflictsWithRunningCompactions(Compaction* c);
+
+        // 将c登记为正在执行的compaction，标记其输入文件并推进该level的压缩点
+        void RegisterCompaction(Compaction* c);
+
         /**
          * 将当前内容保存到*log
          */
@@ -344,8 +392,9 @@ namespace leveldb {
          uint64_t next_file_number_;
          // 当前manifest文件的编号
          uint64_t manifest_file_number_;
-         // 上一个key的序号
-         uint64_t last_sequence_;
+         // 上一个key的序号，读操作不持有锁，使用release/acquire发布，
+         // 保证读到该序号时，序号不超过它的数据都已经写入memtable
+         std::atomic<uint64_t> last_sequence_;
          // 日志文件编号
          uint64_t log_number_;
          uint64_t prev_log_number_;
@@ -356,6 +405,9 @@ namespace leveldb {
          // 后会被追加写入此日志文件。在第一次创建并打开一个manifest文件时，将其
          // 指向封装为Writer的manifest文件。
          log::Writer* descriptor_log_;
+         // 等待执行LogAndApply的线程，memtable落盘与compaction在不同的后台线程中进行，
+         // 通过该队列保证同一时刻只有队首的线程在写manifest文件
+         std::deque<port::CondVar*> manifest_writers_;
          // Version双向链表的头节点
          Version dummy_versions_;
          // 指向当前最新的Version
@@ -363,6 +415,9 @@ namespace leveldb {
 
          // 每个level的下一次compaction操作的起始key
          std::string compact_pointer_[config::kNumLevels];
+
+         // 正在执行的compaction
+         std::vector<Compaction*> running_compactions_;
     };
 
     class Compaction {
@@ -402,6 +457,11 @@ namespace leveldb {
         // compaction完成后释放input
         void ReleaseInputs();
 
+        // 构造一个输入与此compaction相同的Compaction对象，供子compaction使用。
+        // ShouldStopBefore()和IsBaseLevelForKey()会记录遍历的位置，
+        // 所以并行处理不同key range的子compaction需要各自使用一个对象
+        Compaction* NewSubcompaction() const;
+
     private:
         friend class Version;
         friend class VersionSet;
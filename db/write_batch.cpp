@@ -133,14 +133,24 @@ namespace leveldb {
         public:
             SequenceNumber sequence_;
             MemTable* mem_;
+            // 是否可能有其他线程同时向mem_插入数据
+            bool concurrent_;
 
             void Put(const Slice& key, const Slice& value) override {
-                mem_->Add(sequence_, kTypeValue, key, value);
-                sequence_++;
+                Add(kTypeValue, key, value);
             }
 
             void Delete(const Slice& key) override {
-                mem_->Add(sequence_, kTypeDeletion, key, Slice());
+                Add(kTypeDeletion, key, Slice());
+            }
+
+        private:
+            void Add(ValueType type, const Slice& key, const Slice& value) {
+                if(concurrent_) {
+                    mem_->AddConcurrently(sequence_, type, key, value);
+                } else {
+                    mem_->Add(sequence_, type, key, value);
+                }
                 sequence_++;
             }
         };
@@ -153,10 +163,20 @@ namespace leveldb {
         // 获取序号
         inserter.sequence_ = WriteBatchInternal::Sequence(b);
         inserter.mem_ = memtable;
+        inserter.concurrent_ = false;
         // 遍历WriteBatch b，并通过MemTableInserter inserter 将数据插入到MemTable memtable
         return b->Iterate(&inserter);
     }
 
+    // 与InsertInto相同，但允许多个线程同时向memtable插入各自的WriteBatch
+    Status WriteBatchInternal::InsertIntoConcurrently(const WriteBatch *b, MemTable *memtable) {
+        MemTableInserter inserter;
+        inserter.sequence_ = WriteBatchInternal::Sequence(b);
+        inserter.mem_ = memtable;
+        inserter.concurrent_ = true;
+        return b->Iterate(&inserter);
+    }
+
     void WriteBatchInternal::SetContents(WriteBatch *b, const Slice &contents) {
         assert(contents.size() >= kHeader);
         b->rep_.assign(contents.data(), contents.size());
@@ -38,6 +38,9 @@ namespace leveldb {
 
         static Status InsertInto(const WriteBatch* batch, MemTable* memTable);
 
+        // InsertInto的并发版本，多个线程可以同时将各自的batch插入同一个memtable
+        static Status InsertIntoConcurrently(const WriteBatch* batch, MemTable* memTable);
+
         static void Append(WriteBatch* batch, const WriteBatch* src);
     };
 
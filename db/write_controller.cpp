@@ -0,0 +1,82 @@
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+    // 延迟写入时目标速率的下限，避免写入被无限期地拖住
+    static const uint64_t kMinDelayedWriteRate = 16 * 1024;
+
+    // 令牌桶最多积累的额度（以目标速率写入多少微秒的数据），限制空闲之后的突发写入
+    static const uint64_t kMaxBurstMicros = 1000;
+
+    WriteController::WriteController(const Options& options)
+        : level0_slowdown_trigger_(options.level0_slowdown_writes_trigger),
+          level0_stop_trigger_(options.level0_stop_writes_trigger),
+          soft_limit_(options.soft_pending_compaction_bytes_limit),
+          hard_limit_(options.hard_pending_compaction_bytes_limit),
+          max_rate_(options.delayed_write_rate),
+          stopped_(false),
+          delayed_(false),
+          rate_(options.delayed_write_rate),
+          credit_(0),
+          last_refill_micros_(0) {}
+
+    void WriteController::Update(int level0_files, uint64_t compaction_debt) {
+        stopped_ = level0_files >= level0_stop_trigger_ ||
+                   (hard_limit_ > 0 && compaction_debt >= hard_limit_);
+
+        // 积压程度，0表示刚好达到软限制，越接近1表示越接近硬限制
+        double pressure = -1;
+        if(level0_files >= level0_slowdown_trigger_) {
+            // 达到slowdown时就需要开始限速，因此分子分母都加1
+            pressure = static_cast<double>(level0_files - level0_slowdown_trigger_ + 1) /
+                       (level0_stop_trigger_ - level0_slowdown_trigger_ + 1);
+        }
+        if(soft_limit_ > 0 && compaction_debt >= soft_limit_) {
+            double debt_pressure = 1;
+            if(hard_limit_ > soft_limit_) {
+                debt_pressure = static_cast<double>(compaction_debt - soft_limit_) /
+                                (hard_limit_ - soft_limit_);
+            }
+            pressure = std::max(pressure, debt_pressure);
+        }
+
+        bool was_delayed = delayed_;
+        delayed_ = !stopped_ && pressure >= 0;
+        if(!delayed_) {
+            rate_ = max_rate_;
+            return;
+        }
+        // 目标速率随积压程度线性下降
+        double rate = max_rate_ * (1 - std::min(pressure, 1.0));
+        rate_ = std::max(static_cast<uint64_t>(rate), std::min(kMinDelayedWriteRate, max_rate_));
+        if(!was_delayed) {
+            // 刚进入延迟状态，重新开始计算额度
+            credit_ = 0;
+            last_refill_micros_ = 0;
+        }
+    }
+
+    uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t num_bytes) {
+        if(!delayed_ || num_bytes == 0) {
+            return 0;
+        }
+        if(last_refill_micros_ == 0) {
+            last_refill_micros_ = now_micros;
+        }
+        // 按照目标速率补充自上次以来的额度
+        if(now_micros > last_refill_micros_) {
+            credit_ += static_cast<double>(now_micros - last_refill_micros_) * rate_ / 1e6;
+            credit_ = std::min(credit_, static_cast<double>(rate_) * kMaxBurstMicros / 1e6);
+            last_refill_micros_ = now_micros;
+        }
+        // 先扣除本次写入的字节数，额度不足的部分需要等待补充
+        credit_ -= static_cast<double>(num_bytes);
+        if(credit_ >= 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(-credit_ * 1e6 / rate_);
+    }
+
+} // end namespace leveldb
@@ -0,0 +1,56 @@
+#ifndef LLEVELDB_WRITE_CONTROLLER_H
+#define LLEVELDB_WRITE_CONTROLLER_H
+
+#include <cstdint>
+
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+    // 根据compaction的积压情况控制写入速度。
+    // 积压（L0文件数量、各level超出容量上限的字节数）超过软限制后，写入进入延迟状态，
+    // 此时按照目标速率以令牌桶的方式对写入进行限速，积压越接近硬限制目标速率越低；
+    // 积压达到硬限制后写入完全停止，直到compaction追上。
+    // 非线程安全，由DBImpl在持有mutex_时调用。
+    class WriteController {
+    public:
+        explicit WriteController(const Options& options);
+
+        WriteController(const WriteController&) = delete;
+        WriteController& operator=(const WriteController&) = delete;
+
+        // 根据当前L0的文件数量和compaction负债更新写入状态及目标速率
+        void Update(int level0_files, uint64_t compaction_debt);
+
+        // 写入是否需要完全停止
+        bool IsStopped() const { return stopped_; }
+
+        // 写入是否需要限速
+        bool NeedsDelay() const { return delayed_; }
+
+        // 当前的目标写入速率，单位为字节/秒
+        uint64_t delayed_write_rate() const { return rate_; }
+
+        // 在now_micros时刻写入num_bytes字节前需要等待的微秒数，返回0表示无需等待。
+        // 调用方需要在返回的时间之后才真正写入。
+        uint64_t GetDelay(uint64_t now_micros, uint64_t num_bytes);
+
+    private:
+        const int level0_slowdown_trigger_;
+        const int level0_stop_trigger_;
+        const uint64_t soft_limit_;
+        const uint64_t hard_limit_;
+        const uint64_t max_rate_;
+
+        bool stopped_;
+        bool delayed_;
+        uint64_t rate_;
+        // 令牌桶中的剩余额度，单位为字节；为负数时表示已经透支，需要等待补充
+        double credit_;
+        // 上次补充额度的时间
+        uint64_t last_refill_micros_;
+    };
+
+} // end namespace leveldb
+
+#endif //LLEVELDB_WRITE_CONTROLLER_H
@@ -12,8 +12,20 @@
 namespace leveldb {
 
     class LEVELDB_EXPORT Cache;
-    // 创建Cache的全局方法
-    LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
+    // 创建Cache的全局方法。
+    // high_pri_pool_ratio为高优先级缓存项最多可以占用的容量比例（[0, 1]），
+    // 高优先级缓存项只有在低优先级的缓存项全部被淘汰后才会被淘汰，超出该比例的部分按低优先级处理；
+    // 为0时所有缓存项都按低优先级处理，即普通的LRU。
+    // admission_policy为true时启用TinyLFU准入策略：记录各个key近期被Lookup()的频率，
+    // 缓存已满时只有比即将被淘汰的缓存项访问更频繁的新缓存项才会被放入缓存，
+    // 否则Insert()返回的节点不在缓存中，Release()时直接删除。高优先级的缓存项不受准入策略限制。
+    // 可以防止大范围的扫描将热点数据挤出缓存，代价是新的热点数据需要被访问两次以上才能进入缓存
+    LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio = 0.0,
+                                      bool admission_policy = false);
+    // 创建一个使用CLOCK算法淘汰的Cache，分为 1 << num_shard_bits 个分片。
+    // Lookup()与Release()不需要加锁，适用于多线程频繁读取热点block的场景；
+    // 缓存项较小时槽位可能先于容量用满，此时会提前淘汰缓存项
+    LEVELDB_EXPORT Cache* NewClockCache(size_t capacity, int num_shard_bits = 4);
 
     class LEVELDB_EXPORT Cache {
     public:
@@ -25,11 +37,23 @@ namespace leveldb {
         // 表示节点的结构体
         struct Handle {};
 
+        // 缓存项的优先级，index block、filter block等元数据使用高优先级，
+        // 避免大范围的扫描将其挤出缓存
+        enum class Priority { kHigh, kLow };
+
         // 插入KV对，指定占用的缓存大小（charge），并返回插入的节点。
-        // 删除KV对时调用传入deleter函数。
+        // 删除KV对时调用传入deleter函数，调用时不持有缓存内部的锁，因此deleter中可以访问其他Cache。
         virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                                void (*deleter)(const Slice& key, void* value)) = 0;
 
+        // 与上面的Insert()相同，并指定缓存项的优先级。
+        // 默认实现忽略优先级
+        virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                               void (*deleter)(const Slice& key, void* value),
+                               Priority) {
+            return Insert(key, value, charge, deleter);
+        }
+
         // 根据key查找数据，返回查找到的节点，若未找到
         // 则返回nullptr
         virtual Handle* Lookup(const Slice& key) = 0;
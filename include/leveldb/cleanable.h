@@ -0,0 +1,55 @@
+#ifndef CLEANABLE_H_
+#define CLEANABLE_H_
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+    // 持有一组cleanup函数，在析构时依次调用，用于释放对象所引用的外部资源（如缓存句柄）。
+    // Iterator与PinnableSlice都继承自Cleanable，迭代器可以将其cleanup函数转移给PinnableSlice，
+    // 使得迭代器析构后其所引用的数据仍然有效。
+    class LEVELDB_EXPORT Cleanable {
+    public:
+        Cleanable();
+        Cleanable(const Cleanable&) = delete;
+        Cleanable& operator=(const Cleanable&) = delete;
+
+        ~Cleanable();
+
+        // 注册一个在析构或Reset()时调用的函数(*function)(arg1, arg2)
+        using CleanupFunction = void (*)(void* arg1, void* arg2);
+        void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
+
+        // 将当前对象的所有cleanup函数转移给other，转移后当前对象不再持有任何cleanup函数
+        void DelegateCleanupsTo(Cleanable* other);
+
+        // 立即调用所有cleanup函数并清空
+        void Reset();
+
+    private:
+        // Cleanup函数存在一个单链表中，单链表的头节点内联在对象中
+        struct CleanupNode {
+            // 如果该节点未使用的话返回true，需要注意的是只有头节点可能未被使用
+            bool IsEmpty() const {
+                return function == nullptr;
+            }
+            // 调用cleanup函数
+            void Run() {
+                (*function)(arg1, arg2);
+            }
+            // 若该函数指针非空的话则该头节点已被使用
+            CleanupFunction function;
+            void* arg1;
+            void* arg2;
+            CleanupNode* next;
+        };
+
+        // 调用所有cleanup函数，并释放头节点之外的节点
+        void DoCleanup();
+
+        CleanupNode cleanup_head_;
+    };
+
+} // namespace leveldb
+
+#endif // CLEANABLE_H_
@@ -7,10 +7,13 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 
 namespace leveldb {
 
@@ -58,6 +61,18 @@ namespace leveldb {
         virtual Status Get(const ReadOptions& options, const Slice& key,
                            std::string* value) = 0;
 
+        // 与上面的Get相同，但尽量不拷贝value：若value位于block cache中的data block或memtable中，
+        // 则*value直接引用该数据并pin住其所在的block或memtable，直到*value析构或被Reset()。
+        // 调用前*value需处于空的状态（新构造或已Reset()）
+        virtual Status Get(const ReadOptions& options, const Slice& key,
+                           PinnableSlice* value) = 0;
+
+        // 批量查询keys中的各个key，(*values)[i]、(*statuses)[i]分别保存keys[i]的value和查询状态，
+        // 查询结果与对每个key分别调用Get相同，但整个批次只获取一次锁、使用同一个快照，
+        // 并且落在同一个SSTable、同一个data block中的key只需读取一次
+        virtual void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                              std::vector<std::string>* values, std::vector<Status>* statuses) = 0;
+
         virtual Iterator* NewIterator(const ReadOptions& options) = 0;
 
         virtual const Snapshot* GetSnapshot() = 0;
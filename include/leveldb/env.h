@@ -122,9 +122,23 @@ namespace leveldb {
         virtual Status UnlockFile(FileLock* lock) = 0;
 
 
-        // 在后台线程中安排运行一次(*function)(void* arg)
+        // 后台线程池的优先级：HIGH线程池用于memtable落盘，LOW线程池用于compaction，
+        // 两个线程池互不影响，落盘不会被耗时的compaction阻塞
+        enum Priority { LOW, HIGH };
+
+        // 在后台线程中安排运行一次(*function)(void* arg)，等价于使用LOW优先级的线程池
         virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
 
+        // 在指定优先级的后台线程池中安排运行一次(*function)(void* arg)；
+        // 默认实现忽略优先级，直接调用Schedule(function, arg)
+        virtual void Schedule(void (*function)(void* arg), void* arg, Priority) {
+            Schedule(function, arg);
+        }
+
+        // 设置指定优先级的线程池中的后台线程数量，默认每个线程池各有一个线程；
+        // 默认实现不做任何事
+        virtual void SetBackgroundThreads(int, Priority) {}
+
         // 启动一个新线程，在新线程中调用(*function)(void* arg)；
         // 函数返回后销毁该线程；
         virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -278,6 +292,14 @@ namespace leveldb {
             return target_->Schedule(f, a);
         }
 
+        void Schedule(void (*f)(void*), void* a, Priority pri) override {
+            return target_->Schedule(f, a, pri);
+        }
+
+        void SetBackgroundThreads(int number, Priority pri) override {
+            return target_->SetBackgroundThreads(number, pri);
+        }
+
         void StartThread(void (*f)(void*), void* a) override {
             return target_->StartThread(f, a);
         }
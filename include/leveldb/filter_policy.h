@@ -19,6 +19,9 @@ namespace leveldb {
         // 当CreateFilter传入keys所创建的filter包含key时，返回true。
         // 当不包含时返回true或false，返回false的概率应该更高
         virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+        // 批量判断keys[0, n-1]是否可能存在于filter中，结果存入may_match[0, n-1]。
+        // 默认实现逐个调用KeyMayMatch，实现可以重写以使多个key的内存访问相互重叠
+        virtual void KeysMayMatch(int n, const Slice* keys, const Slice& filter, bool* may_match) const;
 
     };
 
@@ -27,6 +30,19 @@ namespace leveldb {
     // 当bits_per_key为10时，误报率大概为1%，这是一个比较理想的情况
     LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+    // 返回一个cache line局部的布隆过滤器：一个key的所有探测都落在同一个64字节的cache line中，
+    // 因此每次查询最多一次cache miss，在x86-64上支持AVX2时会使用SIMD进行探测。
+    // 代价是相同bits_per_key下误报率比NewBloomFilterPolicy略高。
+    // 其Name()与NewBloomFilterPolicy不同，切换策略后旧SSTable中的filter不会被使用，但仍可正常读取。
+    // 每个filter至少占用64字节，因此适合与Options::full_filter一起使用。
+    LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key);
+
+    // 返回一个XOR filter（binary fuse filter）：每个key约占用9 bit，误报率约0.4%，
+    // Bloom filter达到相同的误报率需要约12 bit，因此可以节省约25%的filter内存。
+    // 代价是构造filter时需要更多的CPU与内存，适合只构造一次的SSTable filter。
+    // key较少时数组的相对开销较大，因此适合与Options::full_filter一起使用。
+    LEVELDB_EXPORT const FilterPolicy* NewXorFilterPolicy();
+
 } // end namespace leveldb
 
 
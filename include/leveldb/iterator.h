@@ -16,12 +16,13 @@
 
 #ifndef ITERATOR_H
 #define ITERATOR_H
+#include "leveldb/cleanable.h"
 #include "leveldb/export.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
-    class LEVELDB_EXPORT Iterator {
+    class LEVELDB_EXPORT Iterator : public Cleanable {
         public:
         Iterator();
         Iterator(const Iterator&) = delete;
@@ -53,38 +54,10 @@ namespace leveldb {
         virtual Slice value() const = 0;
         // If an error has occurred, return it.  Else return an ok status.
         virtual Status status() const = 0;
+
         // Clients are allowed to register function/arg1/arg2 triples that
         // will be invoked when this iterator is destroyed.
-        //
-        // Note that unlike all of the preceding methods, this method is
-        // not abstract and therefore clients should not override it.
-        // 定义一个函数指针
-        using CleanupFunction = void (*)(void* arg1, void* arg2); 
-        void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
-
-        private:
-        // Cleanup functions are stored in a single-linked list.
-        // The list's head node is inlined in the iterator.
-        // Cleanup函数存在一个单链表中，单链表的头节点内联在迭代器中
-        struct CleanupNode {
-            // True if the node is not used. Only head nodes might be unused.
-            // 如果该节点未使用的话返回true，需要注意的是只有头节点可能未被使用
-            bool IsEmpty() const {
-                return function == nullptr;
-            }
-            // 调用cleanup函数
-            void Run() {
-                assert(function != nullptr);
-                (*function)(arg1, arg2);
-            }
-            // 若该函数指针非空的话则该头节点已被使用
-            CleanupFunction function;
-            void* arg1;
-            void* arg2;
-            CleanupNode* next;
-        };
-
-        CleanupNode cleanup_head_;
+        // RegisterCleanup()继承自Cleanable，迭代器析构时会调用已注册的cleanup函数
     };
     // 返回一个空的迭代器
     LEVELDB_EXPORT Iterator* NewEmptyIterator();
@@ -4,6 +4,7 @@
 
 
 #include <cstddef>
+#include <cstdint>
 #include "leveldb/export.h"
 
 namespace leveldb {
@@ -13,6 +14,9 @@ namespace leveldb {
     class Env;
     class FilterPolicy;
     class Logger;
+    class PersistentCache;
+    class RateLimiter;
+    class SliceTransform;
     class Snapshot;
 
     // block 中的压缩类型
@@ -62,13 +66,90 @@ namespace leveldb {
         // 默认大小为：4MB
         size_t write_buffer_size = 4 * 1024 * 1024;
 
+        // 内存中最多可同时存在的写缓冲区（memtable + immutable memtable）数量。
+        // 当前memtable写满而之前的immutable memtable还未落盘时，只要总数未超过该值，
+        // 写入就可以切换到新的memtable继续进行，而不必等待落盘完成，从而吸收短时间的写入高峰。
+        // 最小值为2，即与原先只有一个immutable memtable时的行为相同
+        // 默认：2
+        int max_write_buffer_number = 2;
+
+        // 若大于0，则每个memtable会额外分配write_buffer_size * memtable_bloom_size_ratio字节的Bloom filter，
+        // 记录其中的user key，读取memtable中不存在的key时可以不必查找跳表。
+        // filter占用的空间计入memtable的大小，最大为0.25
+        // 默认：0，即不使用
+        double memtable_bloom_size_ratio = 0;
+
         // DB最多可同时打开的文件数目
         int max_open_files = 1000;
 
         // 若非空，则为blocks使用特定的缓存
-        // 若为空，则leveldb会自动创建并使用8MB的内部缓存
+        // 若为空，则leveldb会自动创建并使用8MB的内部缓存。
+        // 多线程读取较多时可以使用NewClockCache()创建的Cache，以减少缓存命中时的锁竞争。
+        // 索引分区以高优先级插入，使用NewLRUCache()的high_pri_pool_ratio可以避免其被扫描挤出缓存
         Cache* block_cache = nullptr;
 
+        // 若非空，则作为block_cache之后的二级缓存，保存压缩后的block的原始数据。
+        // 压缩的block在block_cache中同时保存其原始数据（计入block_cache的容量），被block_cache淘汰时降级到该缓存；
+        // block_cache未命中时先查找该缓存，命中时只需解压而不需要读取文件，并将block从该缓存提升回block_cache。
+        // 两级缓存中的block互不重复，相同的内存可以缓存更多的block，适用于block_cache容纳不下热点数据且压缩率较高的场景。
+        // 没有压缩的block不会放入该缓存。该缓存必须与block_cache不同，并且在block_cache之后释放
+        // 默认：nullptr
+        Cache* compressed_block_cache = nullptr;
+
+        // 若非空，则作为block_cache与compressed_block_cache之后的又一级缓存，将block的原始数据保存在本地磁盘上，
+        // 见NewPersistentCache()。key由DB的唯一标识（保存在DB目录下的IDENTITY文件中）、SSTable的文件编号与大小
+        // 以及block的偏移组成，删除并重新创建的DB具有新的标识，不会读到之前缓存的block
+        // 默认：nullptr
+        PersistentCache* persistent_cache = nullptr;
+
+        // 若非空，则用于缓存点查在SSTable中找到的key-value对，key由SSTable的文件编号与user key组成。
+        // 命中时直接返回缓存的value，省去查找filter、index block与data block的开销，适用于读取集中在少数热点key的场景。
+        // 缓存的是该SSTable中该user key的最新版本，早于该版本的快照读取时仍然读取SSTable。
+        // ReadOptions::fill_cache为false时只查找而不放入。
+        // SSTable被删除时不会清除其缓存项：文件编号不会被重用，这些缓存项不会再被命中，直到被LRU淘汰前仍占用容量
+        // 可以被多个DB共享，由调用方负责释放
+        // 默认：nullptr
+        Cache* row_cache = nullptr;
+
+        // 同一个DB最多可同时执行的compaction数量，同时执行的compaction之间不会有重叠的输入文件，
+        // 输出到同一level时key range也不会重叠（例如L0->L1与L3->L4可以同时进行）。
+        // 实际的并发度还受Env中LOW优先级线程池的线程数量限制，
+        // 需要同时通过Env::SetBackgroundThreads()调整。
+        // 默认：1
+        int max_background_compactions = 1;
+
+        // 一次compaction最多被划分成的子compaction数量。compaction的key range按输入文件的边界
+        // 被划分为数据量大致相同的多个子范围，由各自的线程并行合并并生成输出文件，最后所有输出
+        // 文件在同一个VersionEdit中生效。对于无法与其他compaction并行的L0->L1尤其有用。
+        // 默认：1，即不划分
+        int max_subcompactions = 1;
+
+        // L0的文件数量达到该值时开始对写入限速，文件越多限速越严格
+        // 默认：8
+        int level0_slowdown_writes_trigger = 8;
+
+        // L0的文件数量达到该值时停止写入，直到compaction将其降下来
+        // 默认：12
+        int level0_stop_writes_trigger = 12;
+
+        // compaction负债（各level超出其容量上限、等待被compact的字节数之和，L0达到compaction
+        // 条件时计入其全部大小）达到该值时开始对写入限速，为0表示不根据负债限速
+        // 默认：64GB
+        uint64_t soft_pending_compaction_bytes_limit = 64ull * 1024 * 1024 * 1024;
+
+        // compaction负债达到该值时停止写入，为0表示不根据负债停止写入
+        // 默认：256GB
+        uint64_t hard_pending_compaction_bytes_limit = 256ull * 1024 * 1024 * 1024;
+
+        // 开始限速时的写入速率，单位为字节/秒。积压越接近停止写入的条件，实际速率越低
+        // 默认：16MB/s
+        uint64_t delayed_write_rate = 16 * 1024 * 1024;
+
+        // 若非空，则memtable落盘及compaction写sstable文件、compaction读取输入文件时都会先向其申请IO额度，
+        // 以限制后台IO对前台读写延迟的影响。可以被多个DB共享，由调用方负责释放
+        // 默认：nullptr，即不限速
+        RateLimiter* rate_limiter = nullptr;
+
         // SStable是由block组成的，每个block的默认大小为4KB
         // 需要注意的是，block内会对数据压缩，因此实际读出的数据会小一点
         size_t block_size = 4 * 1024;
@@ -77,6 +158,42 @@ namespace leveldb {
         // 重启点是未压缩的key-value对
         int block_restart_interval = 16;
 
+        // 是否为data block构建hash索引，将每个user key的hash映射到其所在的重启点区间。
+        // 点查时直接定位到该区间，省去在重启点上的二分查找，并且可以直接判断出block中不存在某个user key。
+        // 每个key约额外占用1/data_block_hash_table_util_ratio个字节，重启点多于253个的block不会构建。
+        // 不影响迭代器的Seek，旧的不带hash索引的sstable可以照常读取
+        // 默认：false
+        bool data_block_hash_index = false;
+
+        // hash索引中key的数量与bucket数量之比，越小冲突越少，占用的空间越大
+        // 默认：0.75
+        double data_block_hash_table_util_ratio = 0.75;
+
+        // 是否使用分区索引：将index block切分为多个大小约为index_partition_size的分区，并在其上构建一个顶层索引。
+        // 打开sstable时只读取并常驻很小的顶层索引，各个分区在查找时通过block_cache按需读取，
+        // 适用于文件较大、index block占用内存过多的情况。读取时根据sstable自身的标记识别，与该选项无关
+        // 默认：false
+        bool partition_index = false;
+
+        // 分区索引时每个index分区的大小（未压缩）
+        // 默认：4KB
+        size_t index_partition_size = 4 * 1024;
+
+        // 若为true，则index block（分区索引时为顶层索引）与filter block不再常驻于打开的Table中，
+        // 而是与data block一样以高优先级存放在block_cache中，并按实际大小计入其容量，读取时通过缓存句柄访问。
+        // 这样打开的SSTable占用的内存也受block_cache容量的限制，代价是每次读取多一到两次缓存查找，
+        // 被淘汰后需要重新读取。建议配合NewLRUCache()的high_pri_pool_ratio使用
+        // 默认：false
+        bool cache_index_and_filter_blocks = false;
+
+        // 若大于0，则DB迭代器自上次Seek以来从所有SSTable中读取的data block（包括跨越多个文件的扫描）
+        // 达到该数量后，认为其正在进行大范围的扫描，之后读取的block不再放入block_cache（仍然会在其中查找），
+        // 直到下一次Seek，相当于自动设置ReadOptions::fill_cache为false，避免扫描挤出热点数据。
+        // 每次Seek时各个level都会读取block，因此该值应明显大于level与level0文件数量之和。
+        // 也可以使用NewLRUCache()的admission_policy让缓存自身抵御扫描
+        // 默认：0，即不限制
+        int scan_fill_cache_limit = 0;
+
         // 每个文件最大写入2MB，写满后转到新的文件
         // 每个block是4KB，则每个文件中有512个block
         size_t max_file_size = 2 * 1024 * 1024;
@@ -92,6 +209,32 @@ namespace leveldb {
 
         // 若非空，则使用指定的过滤策略来减少磁盘IO
         const FilterPolicy* filter_policy = nullptr;
+
+        // 为true时每个SSTable只生成一个覆盖所有key的filter（full filter），而不是每2KB数据生成一个filter。
+        // 点查时在查找index之前就可以用它排除不存在的key，假阳性率也更低，但构建SSTable时需要在内存中保存所有key。
+        // 读取时根据SSTable自身的meta index识别，两种格式可以共存
+        // 默认：false
+        bool full_filter = false;
+
+        // 若非空，则用其从key中提取前缀，并与完整的key一同加入filter（需要同时设置filter_policy），
+        // 使用ReadOptions::prefix_same_as_start的迭代器Seek时可以跳过filter中不包含目标前缀的SSTable。
+        // SSTable中记录了提取器的名字，名字不同的SSTable不会用于前缀过滤。
+        // 默认：nullptr
+        const SliceTransform* prefix_extractor = nullptr;
+
+        // 若为true，则启用流水线写入：写log与写memtable分为两个阶段，
+        // 第N+1组writer可以在第N组写memtable的同时写log。各组仍按照写log的
+        // 顺序写入memtable并发布其sequence，因此可见性顺序不变。
+        //
+        // 默认：false
+        bool enable_pipelined_write = false;
+
+        // 若为true，则同一写入组内的各个writer在leader写完log后，
+        // 并行地将各自的WriteBatch插入memtable，而不是由leader串行插入合并后的batch。
+        // 写入组越大、batch越多，收益越明显。
+        //
+        // 默认：false
+        bool allow_concurrent_memtable_write = false;
     }; // end struct Options
 
     // 控制读操作的选项
@@ -112,6 +255,12 @@ namespace leveldb {
         // snapshot of the state at the beginning of this read operation.
         const Snapshot* snapshot = nullptr;
 
+        // 为true且设置了Options::prefix_extractor时，迭代器只返回与Seek()的target具有相同前缀的key，
+        // 遇到前缀不同的key即失效，并且Seek()时会通过filter跳过不包含该前缀的SSTable。
+        // target没有前缀（InDomain()为false）时按全序遍历。
+        // 此时迭代器只支持Seek()、SeekToFirst()（按全序遍历）与Next()，Prev()与SeekToLast()会返回NotSupported。
+        bool prefix_same_as_start = false;
+
     }; // end struct ReadOptions
 
     // 控制写操作的选项
@@ -0,0 +1,49 @@
+#ifndef LLEVELDB_PERSISTENT_CACHE_H
+#define LLEVELDB_PERSISTENT_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+    class Env;
+
+    // 位于本地高速磁盘（如NVMe SSD）上的block缓存，作为block_cache与compressed_block_cache之后的又一级缓存，
+    // 用于DB位于较慢的存储上、而热点数据远大于内存的场景。缓存的内容在重启后依然有效。
+    // 同一个PersistentCache可以被多个DB共享。实现必须是线程安全的。
+    class LEVELDB_EXPORT PersistentCache {
+    public:
+        PersistentCache() = default;
+        PersistentCache(const PersistentCache&) = delete;
+        PersistentCache& operator=(const PersistentCache&) = delete;
+
+        virtual ~PersistentCache();
+
+        // 插入key -> data，key已经存在时不做任何操作。
+        // 缓存的容量不足时淘汰最早插入的数据
+        virtual Status Insert(const Slice& key, const Slice& data) = 0;
+
+        // 查找key，找到时将其数据存入*data并返回OK，找不到时返回NotFound，
+        // 数据校验失败时返回Corruption并删除该项
+        virtual Status Lookup(const Slice& key, std::string* data) = 0;
+
+        // 返回缓存的数据占用的磁盘空间
+        virtual uint64_t TotalSize() const = 0;
+    };
+
+    // 在env的path目录下打开一个最多占用capacity字节的PersistentCache，目录不存在时自动创建。
+    // 数据以追加的方式写入目录下的多个段文件，容量不足时删除最早的段文件。
+    // 段在内存中写满后通过env->Schedule()在后台线程中写入磁盘，写入完成之前仍从内存中读取；
+    // 后台写入跟不上时放弃新的插入。
+    // 打开时扫描已有的段文件重建索引，每条记录都带有CRC校验，遇到损坏的记录时丢弃该段文件的剩余部分。
+    // path应当只被一个PersistentCache使用
+    LEVELDB_EXPORT Status NewPersistentCache(Env* env, const std::string& path, uint64_t capacity,
+                                             PersistentCache** result);
+
+} // end namespace leveldb
+
+#endif //LLEVELDB_PERSISTENT_CACHE_H
@@ -0,0 +1,77 @@
+#ifndef PINNABLE_SLICE_H_
+#define PINNABLE_SLICE_H_
+
+#include <cassert>
+#include <string>
+
+#include "leveldb/cleanable.h"
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+    // DB::Get()的输出类型，可以在不拷贝的情况下直接引用block cache中的data block或memtable中的value。
+    // 处于pinned状态时，PinnableSlice持有相应的缓存句柄（或memtable的引用），在析构或Reset()时释放，
+    // 因此其必须在DB（以及Options::block_cache）被销毁之前析构或Reset()。
+    // 无法pin住数据时（例如数据来自mmap的文件），value会被拷贝到PinnableSlice自己的buffer中。
+    //
+    // 长期持有pinned的PinnableSlice会使对应的data block无法被淘汰，或使对应的memtable无法被释放。
+    class LEVELDB_EXPORT PinnableSlice : public Slice, public Cleanable {
+    public:
+        PinnableSlice() : pinned_(false), buf_(&self_space_) {}
+        // 使用调用者提供的buf保存拷贝的数据
+        explicit PinnableSlice(std::string* buf) : pinned_(false), buf_(buf) {}
+
+        PinnableSlice(const PinnableSlice&) = delete;
+        PinnableSlice& operator=(const PinnableSlice&) = delete;
+
+        // 直接引用s，s所在的存储由cleanable中的cleanup函数负责释放，这些函数会被转移到当前对象
+        void PinSlice(const Slice& s, Cleanable* cleanable) {
+            assert(!pinned_);
+            pinned_ = true;
+            Slice::operator=(s);
+            cleanable->DelegateCleanupsTo(this);
+        }
+
+        // 直接引用s，在当前对象析构或Reset()时调用(*function)(arg1, arg2)释放s所在的存储
+        void PinSlice(const Slice& s, CleanupFunction function, void* arg1, void* arg2) {
+            assert(!pinned_);
+            pinned_ = true;
+            Slice::operator=(s);
+            RegisterCleanup(function, arg1, arg2);
+        }
+
+        // 将s拷贝到buffer中，并引用该buffer
+        void PinSelf(const Slice& s) {
+            assert(!pinned_);
+            buf_->assign(s.data(), s.size());
+            Slice::operator=(*buf_);
+        }
+
+        // 引用buffer，用于通过GetSelf()直接写入buffer之后
+        void PinSelf() {
+            assert(!pinned_);
+            Slice::operator=(*buf_);
+        }
+
+        std::string* GetSelf() { return buf_; }
+
+        // 释放pin住的数据并清空
+        void Reset() {
+            Cleanable::Reset();
+            pinned_ = false;
+            clear();
+        }
+
+        // 是否直接引用了外部的数据，若否则数据位于GetSelf()中
+        bool IsPinned() const { return pinned_; }
+
+    private:
+        bool pinned_;
+        std::string self_space_;
+        std::string* buf_;
+    };
+
+} // namespace leveldb
+
+#endif // PINNABLE_SLICE_H_
@@ -0,0 +1,52 @@
+#ifndef RATE_LIMITER_H_
+#define RATE_LIMITER_H_
+
+#include <cstdint>
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+    class Env;
+
+    // 限制后台IO（memtable落盘、compaction）的速度，避免其占满磁盘带宽而影响前台读写的延迟。
+    // 同一个RateLimiter可以通过Options::rate_limiter被多个DB共享，以限制它们在同一块磁盘上的总IO。
+    // 实现必须是线程安全的。
+    class LEVELDB_EXPORT RateLimiter {
+    public:
+        // IO请求的来源，不同来源使用各自独立的额度
+        enum IOSource {
+            kFlush = 0,
+            kCompaction = 1,
+            kNumIOSources = 2
+        };
+
+        virtual ~RateLimiter();
+
+        // 申请bytes字节的IO额度，额度不足时阻塞直到获得足够的额度
+        virtual void Request(int64_t bytes, IOSource source) = 0;
+
+        // 设置指定来源的速率，单位为字节/秒，<=0表示不限速。开启自动调节时为速率的上限
+        virtual void SetBytesPerSecond(IOSource source, int64_t bytes_per_second) = 0;
+
+        // 返回指定来源当前生效的速率
+        virtual int64_t GetBytesPerSecond(IOSource source) const = 0;
+
+        // 返回指定来源累计申请过的字节数
+        virtual int64_t GetTotalBytesThrough(IOSource source) const = 0;
+    };
+
+    // 创建一个基于令牌桶的RateLimiter，每隔refill_period_us微秒为每个来源补充一次额度。
+    // compaction_bytes_per_second、flush_bytes_per_second分别为compaction和落盘的速率，<=0表示不限速。
+    // 落盘直接影响写入能否继续进行，一般不需要对其限速或者给予较高的速率。
+    // 若auto_tuned为true，则设置的速率作为上限，实际速率根据额度被用尽的频繁程度在
+    // [上限/20, 上限]之间自动调整：额度经常被用尽时提高速率，很少被用尽时降低速率。
+    // env用于获取时间与等待额度，为nullptr时使用Env::Default()，一般应与使用该RateLimiter的DB的Options::env相同。
+    LEVELDB_EXPORT RateLimiter* NewGenericRateLimiter(int64_t compaction_bytes_per_second,
+                                                      int64_t flush_bytes_per_second = 0,
+                                                      int64_t refill_period_us = 100 * 1000,
+                                                      bool auto_tuned = false,
+                                                      Env* env = nullptr);
+
+} // end namespace leveldb
+
+#endif // RATE_LIMITER_H_
@@ -0,0 +1,42 @@
+#ifndef SLICE_TRANSFORM_H_
+#define SLICE_TRANSFORM_H_
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+    // 从key中提取前缀，用于Options::prefix_extractor。
+    // 设置后，filter中除了完整的key之外还会包含每个key的前缀，使用ReadOptions::prefix_same_as_start
+    // 进行Seek时可以通过filter跳过不包含该前缀的SSTable。
+    //
+    // 实现必须是线程安全的，并且满足：
+    //  1. Transform(key)是key的前缀；
+    //  2. 在comparator的顺序下，具有相同前缀的key是连续的（bytewise comparator下总是成立）。
+    class LEVELDB_EXPORT SliceTransform {
+    public:
+        virtual ~SliceTransform();
+
+        // 返回SliceTransform的名字，会被记录在SSTable中，
+        // 只有名字相同时才会使用SSTable中的前缀进行过滤，因此改变提取规则时必须同时改变名字
+        virtual const char* Name() const = 0;
+
+        // 返回key的前缀，要求：InDomain(key)为true
+        virtual Slice Transform(const Slice& key) const = 0;
+
+        // key是否有前缀，返回false的key不会将前缀加入filter，也不会使用前缀进行过滤
+        virtual bool InDomain(const Slice& key) const = 0;
+
+        // Transform()返回的两个前缀是否相同，用于在生成filter时去掉相邻key的重复前缀
+        virtual bool SamePrefix(const Slice& a, const Slice& b) const { return a == b; }
+    };
+
+    // 返回一个使用key的前prefix_len个字节作为前缀的SliceTransform，长度小于prefix_len的key没有前缀
+    LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(size_t prefix_len);
+
+    // 返回一个使用key的前cap_len个字节作为前缀的SliceTransform，长度小于cap_len的key整个作为前缀
+    LEVELDB_EXPORT const SliceTransform* NewCappedPrefixTransform(size_t cap_len);
+
+} // end namespace leveldb
+
+#endif // SLICE_TRANSFORM_H_
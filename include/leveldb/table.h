@@ -5,16 +5,21 @@
 #ifndef LLEVELDB_TABLE_H
 #define LLEVELDB_TABLE_H
 
+#include <string>
+
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 
 namespace leveldb {
     class Block;
     class BlockHandle;
+    struct BlockContents;
+    class FilterBlockReader;
     class Footer;
     class Options;
     class RandomAccessFile;
     struct ReadOptions;
+    class ScanTracker;
     class TableCache;
 
 
@@ -43,16 +48,57 @@ namespace leveldb {
         struct Rep;
 
         static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+        // 与上面的BlockReader相同。point_lookup为true时返回只用于点查的迭代器，见Block::NewIterator。
+        // 若pinnable不为nullptr，则通过*pinnable返回block的数据能否在迭代器的cleanup函数执行前一直有效，
+        // 即block位于block cache中或其数据位于堆上。mmap读取的block直接引用文件映射，依赖于Table的生命周期
+        // high_priority为true时以高优先级插入block cache
+        static Iterator* BlockReader(void*, const ReadOptions&, const Slice&, bool point_lookup,
+                                     bool* pinnable, bool high_priority);
+        // 读取分区索引的一个分区，分区以高优先级插入block cache，避免被扫描读入的data block挤出
+        static Iterator* IndexPartitionReader(void*, const ReadOptions&, const Slice&);
         explicit  Table(Rep* rep) :rep_(rep) {};
 
-        // 在当前SSTable内部进行查找目标key
+        // 与NewIterator()相同，读取的data block计入scan_tracker，见Options::scan_fill_cache_limit
+        Iterator* NewIterator(const ReadOptions&, ScanTracker* scan_tracker) const;
+
+        // 在当前SSTable内部进行查找目标key，找到后调用(*handle_result)(arg, k, v, value_pinner)。
+        // 若value_pinner不为nullptr，handle_result可以将其cleanup函数转移走，从而在返回后继续引用v
         Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                            void (*handle_result)(void* arg, const Slice& k,
-                                                const Slice& v));
-        // 读取meta index block ，其中存了filter block 的 handle
-        void ReadMeta(const Footer& footer);
-        // 根据filter block handle读取filter block，并构造一个filter block reader
-        void ReadFilter(const Slice& filter_handle_value);
+                                                const Slice& v, Cleanable* value_pinner));
+        // 在当前SSTable内部批量查找keys[0, n-1]，keys需按照internal key升序排列。
+        // 各个key共用一个index block迭代器，落在同一个data block中的key只读取一次该block。
+        // 对找到的第i个key调用(*handle_result)(arg, i, k, v)
+        Status InternalMultiGet(const ReadOptions&, const Slice* keys, int n, void* arg,
+                                void (*handle_result)(void* arg, int index, const Slice& k,
+                                                      const Slice& v));
+        // 读取handle所指的block，不经过block_cache。依次在Options::compressed_block_cache与
+        // Options::persistent_cache中查找，都未命中时从文件读取并放入persistent_cache。
+        // raw_data不为nullptr表示调用方会将block放入block_cache，并在其被淘汰时降级到compressed_block_cache：
+        // 此时通过*raw_data返回block的原始数据，命中compressed_block_cache时从中删除该block
+        Status ReadBlockContents(const ReadOptions&, const BlockHandle& handle, BlockContents* result,
+                                 std::string* raw_data = nullptr) const;
+        // 设置在Options::persistent_cache中使用的key前缀，需要在重启后仍能唯一地确定该SSTable。
+        // 由TableCache在打开SSTable之后、开始读取之前调用，未设置时不使用persistent_cache
+        void SetPersistentCacheKeyPrefix(const Slice& prefix);
+        // 返回遍历index的迭代器，分区索引时会按需读取各个分区
+        Iterator* NewIndexIterator(const ReadOptions&) const;
+        // 返回遍历index block（分区索引时为顶层索引）的迭代器，
+        // index block位于block cache中时迭代器持有其缓存句柄
+        Iterator* NewIndexBlockIterator(const ReadOptions&) const;
+        // 返回SSTable的filter，没有filter或读取失败时返回nullptr。
+        // filter位于block cache中时，在pinner上注册释放缓存句柄的cleanup函数，
+        // 返回的filter在pinner执行cleanup之前有效
+        FilterBlockReader* GetFilter(const ReadOptions&, Cleanable* pinner) const;
+        // 根据filter判断SSTable中是否可能存在与target前缀相同且不小于target的key，
+        // 没有使用Options::prefix_extractor生成前缀或target没有前缀时返回true。
+        // 要求：具有相同前缀的key在comparator的顺序下是连续的
+        bool PrefixMayMatch(const ReadOptions&, const Slice& target) const;
+        // 读取meta index block ，其中存了filter block 的 handle，以及index block是否是分区索引
+        Status ReadMeta(const Footer& footer);
+        // 根据filter block handle读取filter block，并构造一个filter block reader，
+        // full_filter表示其为覆盖整个SSTable的单个filter
+        void ReadFilter(const Slice& filter_handle_value, bool full_filter);
 
 
         Rep* rep_;
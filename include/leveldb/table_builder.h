@@ -54,6 +54,9 @@ namespace leveldb {
     private:
         bool ok() const { return status().ok(); }
         void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+        void WriteBlock(const Slice& raw, BlockHandle* handle);
+        // 向index block中添加一个data block的索引，分区索引时当前分区写满后将其切分出来
+        void AddIndexEntry(const Slice& key, const BlockHandle& handle);
         void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
 
         struct Rep;
@@ -3,35 +3,53 @@
 #include <cstdint>
 #include <vector>
 
+#include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
 namespace leveldb {
 
-    // 从最后4个字节中解析出重启点的数量
+    // 从最后4个字节中解析出重启点的数量，最高位是hash索引的标记
     inline uint32_t Block::NumRestarts() const {
-        assert(size_ > sizeof(uint32_t));
-        return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+        assert(size_ >= sizeof(uint32_t));
+        return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & ~kBlockHashIndexFlag;
     }
 
     Block::Block(const BlockContents& contents) 
         : data_(contents.data.data()),
           size_(contents.data.size()),
-          owned_(contents.heap_allocated) {
+          owned_(contents.heap_allocated),
+          hash_buckets_(nullptr),
+          num_buckets_(0) {
 
         if(size_ < sizeof(uint32_t)) {
             size_ = 0;
         } else {
-            // 要留出4个字节来存储重启点的数量，计算最多允许的重启点数量，每个重启点需要4个字节来保存其位置偏移
-            size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
+            // block尾部在重启点偏移数组之后的部分：重启点的数量，以及可能存在的hash索引
+            size_t trailer_size = sizeof(uint32_t);
+            if((DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & kBlockHashIndexFlag) != 0) {
+                if(size_ < 2 * sizeof(uint32_t)) {
+                    size_ = 0;
+                    return;
+                }
+                num_buckets_ = DecodeFixed32(data_ + size_ - 2 * sizeof(uint32_t));
+                if(num_buckets_ == 0 || num_buckets_ > size_ - 2 * sizeof(uint32_t)) {
+                    size_ = 0;
+                    return;
+                }
+                trailer_size += sizeof(uint32_t) + num_buckets_;
+                hash_buckets_ = data_ + size_ - trailer_size;
+            }
+            // 计算最多允许的重启点数量，每个重启点需要4个字节来保存其位置偏移
+            size_t max_restarts_allowed = (size_ - trailer_size) / sizeof(uint32_t);
             if(NumRestarts() > max_restarts_allowed) {
                 size_= 0;
             } else {
                 //计算重启点偏移数组的位置
-                // +1 是因为最后4字节是保存的重启点的数量
-                restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+                restart_offset_ = size_ - trailer_size - NumRestarts() * sizeof(uint32_t);
             }
         }
     }
@@ -91,6 +109,8 @@ namespace leveldb {
         const char* const data_; // 当下block的内容
         uint32_t const restarts_; // 重启点偏移数组的位置偏移
         uint32_t const num_restarts_; // 重启点的数量
+        const char* const hash_buckets_; // hash索引的bucket数组，没有hash索引或不是点查时为nullptr
+        uint32_t const num_buckets_; // hash索引的bucket数量
 
         // current_是当前entry的位置偏移，正常情况下 < restarts_
         uint32_t current_;
@@ -128,11 +148,13 @@ namespace leveldb {
 
         public:
         Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-             uint32_t num_restarts)
+             uint32_t num_restarts, const char* hash_buckets, uint32_t num_buckets)
             :   comparator_(comparator),
                 data_(data),
                 restarts_(restarts),
                 num_restarts_(num_restarts),
+                hash_buckets_(hash_buckets),
+                num_buckets_(num_buckets),
                 current_(restarts_),
                 restart_index_(num_restarts_) {
             
@@ -176,6 +198,33 @@ namespace leveldb {
         }
 
         void Seek(const Slice& target) override {
+            // 点查时先通过hash索引直接定位到target的user key所在的重启点区间
+            if(hash_buckets_ != nullptr) {
+                const Slice user_key = ExtractUserKey(target);
+                const uint8_t restart = static_cast<uint8_t>(
+                        hash_buckets_[Hash(user_key.data(), user_key.size(), kHashIndexSeed) % num_buckets_]);
+                if(restart == kHashIndexNoEntry) {
+                    // block中不存在该user key
+                    current_ = restarts_;
+                    restart_index_ = num_restarts_;
+                    key_.clear();
+                    value_.clear();
+                    return;
+                }
+                if(restart != kHashIndexCollision) {
+                    if(restart >= num_restarts_) {
+                        CorruptionError();
+                        return;
+                    }
+                    SeekToRestartPoint(restart);
+                    while(ParseNextKey() && Compare(key_, target) < 0) {
+                        // 线性查找第一个大于等于target的key
+                    }
+                    return;
+                }
+                // 多个重启点区间发生冲突，退化为下面的二分查找
+            }
+
             // 在重启点数组执行二分查找，找到满足key < target key的
             // 最后一个key
             uint32_t left = 0;
@@ -305,7 +354,7 @@ namespace leveldb {
         }
     };
 
-    Iterator* Block::NewIterator(const Comparator* comparator) {
+    Iterator* Block::NewIterator(const Comparator* comparator, bool point_lookup) {
         // 重启点数量就占用一个uint32_t来存储
         if(size_ < sizeof(uint32_t)) {
             return NewErrorIterator(Status::Corruption("bad block contents"));
@@ -317,7 +366,8 @@ namespace leveldb {
             // 返回一个空的迭代器
             return NewEmptyIterator();
         } else {
-            return new Iter(comparator, data_, restart_offset_, num_restarts);
+            return new Iter(comparator, data_, restart_offset_, num_restarts,
+                            point_lookup ? hash_buckets_ : nullptr, num_buckets_);
         }
     }
 
@@ -21,7 +21,10 @@ namespace leveldb {
         ~Block();
 
         size_t size() const { return size_; }
-        Iterator* NewIterator(const Comparator* comparator);
+        // point_lookup为true时返回的迭代器只用于点查：Seek(target)会利用block的hash索引（若有）
+        // 直接定位到target的user key所在的重启点区间，若block中不存在该user key，迭代器直接变为无效，
+        // 否则定位到第一个大于等于target的key。target必须是internal key
+        Iterator* NewIterator(const Comparator* comparator, bool point_lookup = false);
 
 
         private:
@@ -37,6 +40,9 @@ namespace leveldb {
         uint32_t restart_offset_;
         // block是否属于data_
         bool owned_;
+        // hash索引的bucket数组及bucket数量，block没有hash索引时hash_buckets_为nullptr
+        const char* hash_buckets_;
+        uint32_t num_buckets_;
 
     };
 
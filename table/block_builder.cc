@@ -19,13 +19,20 @@
 //     num_restarts: uint32 重启点的数量
 // restarts[i] contains the offset within the block of the ith restart point.
 // restarts[i] 保存了第i个重启点的位置偏移
+//
+// 若options->data_block_hash_index为true，则在重启点之后追加一个hash索引，此时
+// num_restarts的最高位为1，格式见table/format.h中的kBlockHashIndexFlag。
+// hash索引要求key是internal key，只用于data block
 
 #include "table/block_builder.h"
 #include <algorithm>
 #include <cassert>
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "db/dbformat.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb {
     BlockBuilder::BlockBuilder(const Options* options)
@@ -44,12 +51,24 @@ namespace leveldb {
         counter_ = 0;
         finished_ = false;
         last_key_.clear();
+        key_hashes_.clear();
+        key_restarts_.clear();
+    }
+
+    // 根据key的数量计算hash索引的bucket数量
+    static uint32_t NumHashBuckets(size_t num_keys, double util_ratio) {
+        return static_cast<uint32_t>(num_keys / util_ratio) + 1;
     }
 
     size_t BlockBuilder::CurrentSizeEstimate() const {
-        return ( buffer_.size() +
-                 restarts_.size() + sizeof(uint32_t) +
-                 sizeof(uint32_t) );
+        size_t estimate = ( buffer_.size() +
+                            restarts_.size() + sizeof(uint32_t) +
+                            sizeof(uint32_t) );
+        if(!key_hashes_.empty()) {
+            estimate += NumHashBuckets(key_hashes_.size(),
+                                       options_->data_block_hash_table_util_ratio) + sizeof(uint32_t);
+        }
+        return estimate;
     }
 
     Slice BlockBuilder::Finish() {
@@ -57,8 +76,28 @@ namespace leveldb {
         for(size_t i=0; i<restarts_.size(); i++) {
             PutFixed32(&buffer_, restarts_[i]);
         }
+        uint32_t num_restarts = restarts_.size();
+        // 追加hash索引：bucket中保存hash到该bucket的key所在的重启点索引，
+        // 若这些key位于不同的重启点区间，则标记为冲突，查找时退化为二分查找
+        if(!key_hashes_.empty() && restarts_.size() <= kMaxHashIndexRestarts) {
+            const uint32_t num_buckets = NumHashBuckets(key_hashes_.size(),
+                                                        options_->data_block_hash_table_util_ratio);
+            std::string buckets(num_buckets, static_cast<char>(kHashIndexNoEntry));
+            for(size_t i = 0; i < key_hashes_.size(); i++) {
+                char& bucket = buckets[key_hashes_[i] % num_buckets];
+                const uint8_t restart = key_restarts_[i];
+                if(static_cast<uint8_t>(bucket) == kHashIndexNoEntry) {
+                    bucket = static_cast<char>(restart);
+                } else if(static_cast<uint8_t>(bucket) != restart) {
+                    bucket = static_cast<char>(kHashIndexCollision);
+                }
+            }
+            buffer_.append(buckets);
+            PutFixed32(&buffer_, num_buckets);
+            num_restarts |= kBlockHashIndexFlag;
+        }
         // 将重启点的数量添加到buffer_
-        PutFixed32(&buffer_, restarts_.size());
+        PutFixed32(&buffer_, num_restarts);
         // 谁设置结束标记
         finished_ = true;
         return Slice(buffer_);
@@ -111,6 +150,13 @@ namespace leveldb {
         assert(Slice(last_key_) == key);
         counter_++;
 
+        // 记录user key的hash及其所在的重启点，重启点过多时无法构建hash索引，不再记录
+        if(options_->data_block_hash_index && restarts_.size() <= kMaxHashIndexRestarts) {
+            const Slice user_key = ExtractUserKey(key);
+            key_hashes_.push_back(Hash(user_key.data(), user_key.size(), kHashIndexSeed));
+            key_restarts_.push_back(static_cast<uint8_t>(restarts_.size() - 1));
+        }
+
     }
 
 } // end namespace leveldb
\ No newline at end of file
@@ -48,6 +48,9 @@ namespace leveldb {
         bool finished_;
         // 记录最后添加的key
         std::string last_key_;
+        // 启用hash索引时，每个key的user key的hash及其所在的重启点索引
+        std::vector<uint32_t> key_hashes_;
+        std::vector<uint8_t> key_restarts_;
     };
 } // end namespace leveldb
 
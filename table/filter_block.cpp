@@ -4,6 +4,7 @@
 
 #include "table/filter_block.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -13,9 +14,15 @@ namespace leveldb {
     // 1 << 11 = 2048 = 2KB
     static const size_t kFilterBase = 1 << kFilterBaseLg;
 
-    FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy) : policy_(policy) {}
+    FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy, bool full_filter,
+                                           const SliceTransform* prefix_extractor)
+        : policy_(policy), full_filter_(full_filter), prefix_extractor_(prefix_extractor) {}
 
     void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
+        // 所有key共用一个filter，在Finish()时统一生成
+        if(full_filter_) {
+            return;
+        }
         // 每2KB数据生成一个Filter，计算需要生成几个Filter
         uint64_t filter_index = (block_offset / kFilterBase);
         assert(filter_index >= filter_offsets_.size());
@@ -31,12 +38,25 @@ namespace leveldb {
         start_.push_back(keys_.size());
         // 将key存入keys_
         keys_.append(k.data(), k.size());
+
+        if(prefix_extractor_ != nullptr && prefix_extractor_->InDomain(k)) {
+            Slice prefix = prefix_extractor_->Transform(k);
+            if(prefix_start_.empty() || !prefix_extractor_->SamePrefix(prefix, last_prefix_)) {
+                prefix_start_.push_back(prefixes_.size());
+                prefixes_.append(prefix.data(), prefix.size());
+                last_prefix_.assign(prefix.data(), prefix.size());
+            }
+        }
     }
 
     Slice FilterBlockBuilder::Finish() {
         if(!start_.empty()) {
             GenerateFilter();
         }
+        // full filter不需要索引数据
+        if(full_filter_) {
+            return Slice(result_);
+        }
 
         // 需要先将每个filter的位置偏移，也就是filter offset array加入到result，
         // 然后再将第一个filter的offset的位置加入到result
@@ -56,6 +76,14 @@ namespace leveldb {
     }
 
     void FilterBlockBuilder::GenerateFilter() {
+        // 将前缀追加在key之后，与key一同生成filter
+        for(size_t offset : prefix_start_) {
+            start_.push_back(keys_.size() + offset);
+        }
+        keys_.append(prefixes_);
+        prefixes_.clear();
+        prefix_start_.clear();
+
         const size_t num_keys = start_.size();
 
         if(num_keys == 0) {
@@ -80,8 +108,13 @@ namespace leveldb {
         start_.clear();
     }
 
-    FilterBlockReader::FilterBlockReader(const FilterPolicy *policy, const Slice &contents)
-        : policy_(policy), data_(nullptr), offset_(nullptr), num_(0), base_lg_(0) {
+    FilterBlockReader::FilterBlockReader(const FilterPolicy *policy, const Slice &contents, bool full_filter)
+        : policy_(policy), full_filter_(full_filter),
+          data_(nullptr), offset_(nullptr), num_(0), base_lg_(0) {
+        if(full_filter_) {
+            full_filter_data_ = contents;
+            return;
+        }
         // 计算大小
         size_t n = contents.size();
         // 正常不会小于5字节，因为filter偏移数组的位置占4个字节，base_lg占1个字节，这就是5个字节
@@ -102,6 +135,9 @@ namespace leveldb {
     // 每2KB数据生成一个filter，根据data block 的 offset来计算当前data block由
     // 哪个filter进行过滤，并进行过滤匹配
     bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice &key) {
+        if(full_filter_) {
+            return KeyMayMatch(key);
+        }
         // 计算索引
         uint64_t  index = block_offset >> base_lg_;
         if(index < num_) {
@@ -119,4 +155,24 @@ namespace leveldb {
         return true;
     }
 
+    bool FilterBlockReader::KeyMayMatch(const Slice &key) {
+        assert(full_filter_);
+        // 空的filter表示SSTable中没有任何key
+        if(full_filter_data_.empty()) {
+            return false;
+        }
+        return policy_->KeyMayMatch(key, full_filter_data_);
+    }
+
+    void FilterBlockReader::KeysMayMatch(int n, const Slice* keys, bool* may_match) {
+        assert(full_filter_);
+        if(full_filter_data_.empty()) {
+            for(int i = 0; i < n; i++) {
+                may_match[i] = false;
+            }
+            return;
+        }
+        policy_->KeysMayMatch(n, keys, full_filter_data_, may_match);
+    }
+
 } // end namespace leveldb
\ No newline at end of file
@@ -17,15 +17,22 @@
 // 索引数据包括：
 //              1. filter i offset ， 也即第i个filter的位置偏移
 //              2. filter offset's offset, 也即filter的索引的位置偏移
+//
+// 若使用full filter（Options::full_filter），则整个SSTable只有一个覆盖所有key的filter，
+// filter block的内容就是FilterPolicy生成的filter本身，没有索引数据
 
 namespace leveldb {
     class FilterPolicy;
+    class SliceTransform;
     // 一个SSTable只有一个filter block，其内存储了所有block的filter数据。
     // FilterBlockBuilder用于为一个SSTable构建其所有的filter，每个filter是一个string，
     // FilterPolicy会将其存储在filter block 中
     class FilterBlockBuilder {
     public:
-        explicit FilterBlockBuilder(const FilterPolicy* );
+        // full_filter为true时为整个SSTable生成一个filter，此时StartBlock()不起作用。
+        // prefix_extractor不为nullptr时，每个key的前缀也会被加入filter
+        explicit FilterBlockBuilder(const FilterPolicy*, bool full_filter = false,
+                                    const SliceTransform* prefix_extractor = nullptr);
         FilterBlockBuilder(const FilterBlockBuilder& ) = delete;
         FilterBlockBuilder& operator=(const FilterBlockBuilder&) = delete;
 
@@ -33,14 +40,23 @@ namespace leveldb {
         void AddKey(const Slice& key);
         Slice Finish();
 
+        bool full_filter() const { return full_filter_; }
+
     private:
         void GenerateFilter();
 
         const FilterPolicy* policy_;
+        const bool full_filter_;
+        const SliceTransform* prefix_extractor_;
         // 用于构建Filter的所有key
         std::string keys_;
         // keys_中每个key的起始位置，也即其位置偏移
         std::vector<size_t> start_;
+        // 当前filter中各个key的前缀，与key分开保存以使相同的前缀相邻，连续重复的前缀只保存一次
+        std::string prefixes_;
+        std::vector<size_t> prefix_start_;
+        // 最后加入的前缀
+        std::string last_prefix_;
         // 计算得到的filter
         std::string result_;
         // keys_的副本，用于生成filter
@@ -51,13 +67,24 @@ namespace leveldb {
 
     class FilterBlockReader {
     public:
-        // 当前对象存在期间，contents和policy必须保持有效
-        FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+        // 当前对象存在期间，contents和policy必须保持有效。full_filter表示contents是覆盖整个SSTable的单个filter
+        FilterBlockReader(const FilterPolicy* policy, const Slice& contents, bool full_filter = false);
         // 计算得到data block 由哪个filter进行过滤，并进行过滤
         bool KeyMayMatch(uint64_t block_offset, const Slice& key);
+        // 使用覆盖整个SSTable的filter进行过滤，不需要先查找index
+        // 要求：full_filter()为true
+        bool KeyMayMatch(const Slice& key);
+        // 使用覆盖整个SSTable的filter批量过滤keys[0, n-1]，结果存入may_match[0, n-1]
+        // 要求：full_filter()为true
+        void KeysMayMatch(int n, const Slice* keys, bool* may_match);
+
+        bool full_filter() const { return full_filter_; }
 
     private:
         const FilterPolicy* policy_;
+        const bool full_filter_;
+        // full filter的内容
+        Slice full_filter_data_;
         // 指向filter block中第一个filter的位置
         const char* data_;
         // 每个索引数据指向一个filter的位置偏移
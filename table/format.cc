@@ -1,5 +1,7 @@
 #include "table/format.h"
 
+#include <cstring>
+
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -73,11 +75,15 @@ namespace leveldb {
     }
 
     Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, 
-                     const BlockHandle& handle, BlockContents* result) {
+                     const BlockHandle& handle, BlockContents* result,
+                     std::string* raw) {
         
         result->data = Slice();
         result->cacheable = false;
         result->heap_allocated = false;
+        if(raw != nullptr) {
+            raw->clear();
+        }
 
         // 从handle中解析block数据的大小
         size_t n = static_cast<size_t>(handle.size());
@@ -113,6 +119,10 @@ namespace leveldb {
             }
         }
 
+        if(raw != nullptr) {
+            raw->assign(data, n + 1);
+        }
+
         // 根据block类型处理
         switch(data[n]) {
             case kNoCompression:
@@ -157,4 +167,42 @@ namespace leveldb {
 
     }
 
+    Status UncompressBlock(const Slice& raw, BlockContents* result) {
+        result->data = Slice();
+        result->cacheable = false;
+        result->heap_allocated = false;
+        if(raw.empty()) {
+            return Status::Corruption("empty block contents");
+        }
+        // 最后一个字节为压缩类型
+        const char* data = raw.data();
+        const size_t n = raw.size() - 1;
+        switch(data[n]) {
+            case kNoCompression: {
+                char* buf = new char[n];
+                std::memcpy(buf, data, n);
+                result->data = Slice(buf, n);
+                break;
+            }
+            case kSnappyCompression: {
+                size_t ulength = 0;
+                if(!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+                    return Status::Corruption("corrupted compressed block contents");
+                }
+                char* ubuf = new char[ulength];
+                if(!port::Snappy_Uncompress(data, n, ubuf)) {
+                    delete[] ubuf;
+                    return Status::Corruption("corrupted compressed block contents");
+                }
+                result->data = Slice(ubuf, ulength);
+                break;
+            }
+            default:
+                return Status::Corruption("bad block type");
+        }
+        result->cacheable = true;
+        result->heap_allocated = true;
+        return Status::OK();
+    }
+
 } // end namespace leveldb
\ No newline at end of file
@@ -79,6 +79,18 @@ namespace leveldb {
     // and taking the leading 64 bits.
     static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+    // meta index block中filter block的key为前缀加上FilterPolicy::Name()，value为filter block的handle。
+    // kFullFilterKeyPrefix表示filter block是覆盖整个SSTable的单个filter
+    static const char kFilterKeyPrefix[] = "filter.";
+    static const char kFullFilterKeyPrefix[] = "fullfilter.";
+
+    // meta index block中的该项表示index block是分区索引的顶层索引，其value为空。
+    // 顶层索引的每一项为一个index分区中的最后一个key -> 该分区的handle
+    static const char kPartitionedIndexKey[] = "index.partitioned";
+
+    // meta index block中的该项表示filter中还包含了各个key的前缀，其value为Options::prefix_extractor的名字
+    static const char kPrefixExtractorKey[] = "prefix.extractor";
+
     // block由三部分组成：
     // block data <----- 区块存储的数据
     // type       <----- 采用的哪种压缩方式
@@ -87,6 +99,20 @@ namespace leveldb {
     // 1 byte type + 4 byte crc32
     static const size_t kBlockTrailerSize = 5;
 
+    // data block的hash索引（见BlockBuilder），位于重启点偏移数组之后：
+    //     buckets: uint8[num_buckets]  每个bucket保存hash到该bucket的user key所在的重启点索引
+    //     num_buckets: uint32
+    // 此时block末尾的重启点数量的最高位为1，没有hash索引的旧block可以照常读取
+    static const uint32_t kBlockHashIndexFlag = 1u << 31;
+    // bucket中没有任何key
+    static const uint8_t kHashIndexNoEntry = 255;
+    // hash到该bucket的key位于不同的重启点区间
+    static const uint8_t kHashIndexCollision = 254;
+    // 每个bucket用1个字节保存重启点索引，重启点超过该数量的block不构建hash索引
+    static const uint32_t kMaxHashIndexRestarts = 253;
+    // 计算user key的hash时使用的种子
+    static const uint32_t kHashIndexSeed = 0x9e3779b9;
+
     // 顾名思义，Block的内容，此结构体对象用于构建block
     struct BlockContents {
         // 实际数据
@@ -99,9 +125,14 @@ namespace leveldb {
 
     // 根据block handle从指定的文件中读取block
     // 若读取失败则返回non-ok
-    // 若读取成功，则将数据存到*result, 并返回OK
+    // 若读取成功，则将数据存到*result, 并返回OK。
+    // 若raw不为nullptr，则同时将block在文件中的原始数据（未解压的block data + type）存入*raw
     Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, 
-                     const BlockHandle& handle, BlockContents* result);
+                     const BlockHandle& handle, BlockContents* result,
+                     std::string* raw = nullptr);
+
+    // 将ReadBlock()得到的原始数据（block data + type）解压为block的内容，*result的数据位于堆上
+    Status UncompressBlock(const Slice& raw, BlockContents* result);
 
 
     inline BlockHandle::BlockHandle()
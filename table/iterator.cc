@@ -1,12 +1,22 @@
 #include "leveldb/iterator.h"
 
 namespace leveldb {
-    Iterator::Iterator() {
+    Cleanable::Cleanable() {
         cleanup_head_.function = nullptr;
         cleanup_head_.next = nullptr;
     }
 
-    Iterator::~Iterator() {
+    Cleanable::~Cleanable() {
+        DoCleanup();
+    }
+
+    void Cleanable::Reset() {
+        DoCleanup();
+        cleanup_head_.function = nullptr;
+        cleanup_head_.next = nullptr;
+    }
+
+    void Cleanable::DoCleanup() {
         if(!cleanup_head_.IsEmpty()) {
             // 调用cleanup函数
             cleanup_head_.Run();
@@ -19,7 +29,7 @@ namespace leveldb {
         }
     }
 
-    void Iterator::RegisterCleanup(CleanupFunction func, void* arg1, void* arg2) {
+    void Cleanable::RegisterCleanup(CleanupFunction func, void* arg1, void* arg2) {
         assert(func != nullptr);
         CleanupNode* node;
         // 若头节点为空，则赋值给头节点，否则创建后继节点
@@ -35,6 +45,28 @@ namespace leveldb {
         node->arg2 = arg2;
     }
 
+    void Cleanable::DelegateCleanupsTo(Cleanable* other) {
+        assert(other != this);
+        if(cleanup_head_.IsEmpty()) {
+            return;
+        }
+        // 头节点内联在对象中，需要重新注册；后继节点直接挂到other的链表上
+        other->RegisterCleanup(cleanup_head_.function, cleanup_head_.arg1, cleanup_head_.arg2);
+        CleanupNode* node = cleanup_head_.next;
+        while(node != nullptr) {
+            CleanupNode* next_node = node->next;
+            node->next = other->cleanup_head_.next;
+            other->cleanup_head_.next = node;
+            node = next_node;
+        }
+        cleanup_head_.function = nullptr;
+        cleanup_head_.next = nullptr;
+    }
+
+    Iterator::Iterator() = default;
+
+    Iterator::~Iterator() = default;
+
     namespace {
         // EmptyIterator 类，实现所有接口，但全部都是空实现
         class EmptyIterator : public Iterator {
@@ -3,10 +3,15 @@
 //
 
 #include "leveldb/table.h"
+
+#include <memory>
+
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -26,11 +31,27 @@ namespace leveldb {
         Status status;
         RandomAccessFile* file;
         uint64_t cache_id;
+        // 在compressed_block_cache中的cache id，两个缓存可能被不同的DB共享，因此分别分配
+        uint64_t compressed_cache_id;
+        // 在persistent_cache中的key前缀，为空时不使用persistent_cache，见Table::SetPersistentCacheKeyPrefix()
+        std::string persistent_cache_key_prefix;
         FilterBlockReader* filter;
         const char* filter_data;
 
         BlockHandle metaindex_handle;
+        // 为true时index block与filter block存放在block cache中，index_block与filter为nullptr，
+        // 读取时根据index_handle与filter_handle在block cache中查找
+        bool cache_meta_blocks;
+        BlockHandle index_handle;
+        BlockHandle filter_handle;
+        // filter_handle是否有效，以及其是否为full filter
+        bool has_filter;
+        bool full_filter;
+        // 分区索引时为常驻内存的顶层索引，各个分区通过block cache按需读取
         Block* index_block;
+        bool index_partitioned;
+        // filter中是否包含由Options::prefix_extractor生成的前缀
+        bool prefix_filtering;
     };
 
     // 所谓Open打开SSTable实际就是先打开SSTable对应的文件，然后读出
@@ -56,74 +77,119 @@ namespace leveldb {
         if(!s.ok()) return s;
 
         // ===================================== 根据footer 读取index block
+        // index block存放在block cache中时，在第一次使用时再读取
+        const bool cache_meta_blocks = options.cache_index_and_filter_blocks && options.block_cache != nullptr;
         BlockContents index_block_contents;
         ReadOptions opt;
         if(options.paranoid_checks) {
             opt.verify_checksums = true;
         }
-        // 通过随机读来获取index block contents
-        s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+        if(!cache_meta_blocks) {
+            // 通过随机读来获取index block contents
+            s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+        }
 
         if(s.ok()) {
             // 根据读到的index block的内容构造index block
-            Block* index_block = new Block(index_block_contents);
+            Block* index_block = cache_meta_blocks ? nullptr : new Block(index_block_contents);
             Rep* rep = new Table::Rep;
             rep->options = options;
             rep->file;
             rep->metaindex_handle = footer.metaindex_handle();
+            rep->cache_meta_blocks = cache_meta_blocks;
+            rep->index_handle = footer.index_handle();
+            rep->has_filter = false;
+            rep->full_filter = false;
             rep->index_block = index_block;
+            rep->index_partitioned = false;
+            rep->prefix_filtering = false;
             rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+            rep->compressed_cache_id = (options.compressed_block_cache ?
+                                        options.compressed_block_cache->NewId() : 0);
             rep->filter_data = nullptr;
             rep->filter = nullptr;
             *table = new Table(rep);
-            (*table)->ReadMeta(footer);
+            // 无法读取meta index block时无法判断index block是否是分区索引，只能报错
+            s = (*table)->ReadMeta(footer);
+            if(!s.ok()) {
+                delete *table;
+                *table = nullptr;
+            }
         }
 
         return s;
 
     }
 
-    // 读取meta index block ，其中存了filter block 的 handle
-    void Table::ReadMeta(const Footer &footer) {
-        // 没有过滤策略则没有继续读的必要
-        if(rep_->options.filter_policy == nullptr) {
-            return ;
-        }
-
+    // 读取meta index block ，其中存了filter block 的 handle，以及index block是否是分区索引
+    Status Table::ReadMeta(const Footer &footer) {
         ReadOptions opt;
         if(rep_->options.paranoid_checks) {
             opt.verify_checksums = true;
         }
         // 读取meta index block contents
         BlockContents contents;
-        if(!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-            return ;
+        Status s = ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents);
+        if(!s.ok()) {
+            return s;
         }
         // 根据contents构造block
         Block* meta = new Block(contents);
 
         Iterator* iter = meta->NewIterator(BytewiseComparator());
-        // meta index block是 filte.Name->filter block handle 的映射
-        // 构造Key
-        std::string key = "filter.";
-        key.append(rep_->options.filter_policy->Name());
-        iter->Seek(key);
-        // 读取value
-        if(iter->Valid() && iter->key() == Slice(key)) {
-            ReadFilter(iter->value());
+        iter->Seek(kPartitionedIndexKey);
+        if(iter->Valid() && iter->key() == Slice(kPartitionedIndexKey)) {
+            rep_->index_partitioned = true;
+        }
+        // 有过滤策略时才需要读取filter block
+        if(rep_->options.filter_policy != nullptr) {
+            // meta index block是 filte.Name->filter block handle 的映射，
+            // 优先查找覆盖整个SSTable的full filter
+            // 构造Key
+            std::string full_key = kFullFilterKeyPrefix;
+            full_key.append(rep_->options.filter_policy->Name());
+            std::string key = kFilterKeyPrefix;
+            key.append(rep_->options.filter_policy->Name());
+            iter->Seek(full_key);
+            if(iter->Valid() && iter->key() == Slice(full_key)) {
+                ReadFilter(iter->value(), true);
+            } else {
+                iter->Seek(key);
+                // 读取value
+                if(iter->Valid() && iter->key() == Slice(key)) {
+                    ReadFilter(iter->value(), false);
+                }
+            }
+            // 只有SSTable的前缀由当前的提取器生成时才能使用前缀进行过滤
+            if((rep_->filter != nullptr || rep_->has_filter) && rep_->options.prefix_extractor != nullptr) {
+                iter->Seek(kPrefixExtractorKey);
+                if(iter->Valid() && iter->key() == Slice(kPrefixExtractorKey) &&
+                   iter->value() == Slice(rep_->options.prefix_extractor->Name())) {
+                    rep_->prefix_filtering = true;
+                }
+            }
         }
+        s = iter->status();
         delete iter;
         delete meta;
+        return s;
     }
 
     // 根据filter block handle读取filter block，并构造一个filter block reader
-    void Table::ReadFilter(const Slice &filter_handle_value) {
+    void Table::ReadFilter(const Slice &filter_handle_value, bool full_filter) {
         Slice v = filter_handle_value;
         BlockHandle filter_handle;
         // 提取filter handle
         if(!filter_handle.DecodeFrom(&v).ok()) {
             return ;
         }
+        // filter block存放在block cache中，在第一次使用时再读取
+        if(rep_->cache_meta_blocks) {
+            rep_->filter_handle = filter_handle;
+            rep_->has_filter = true;
+            rep_->full_filter = full_filter;
+            return ;
+        }
 
         ReadOptions opt;
         if(rep_->options.paranoid_checks) {
@@ -140,7 +206,7 @@ namespace leveldb {
             rep_->filter_data = block.data.data();
         }
 
-        rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+        rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data, full_filter);
     }
 
     Table::~Table() { delete rep_; }
@@ -160,13 +226,128 @@ namespace leveldb {
         cache->Release(handle);
     }
 
+    // block cache中的filter，reader引用的数据位于堆上时由heap_data持有
+    struct CachedFilter {
+        FilterBlockReader* reader;
+        const char* heap_data;
+    };
+
+    static void DeleteCachedFilter(const Slice&, void* value) {
+        CachedFilter* filter = reinterpret_cast<CachedFilter*>(value);
+        delete filter->reader;
+        delete[] filter->heap_data;
+        delete filter;
+    }
+
+    static void DeleteCompressedBlock(const Slice&, void* value) {
+        delete reinterpret_cast<std::string*>(value);
+    }
+
+    // block_cache中的压缩block，同时保存其原始数据。
+    // 被block_cache淘汰时将原始数据降级到compressed_block_cache，使两级缓存中的block互不重复
+    struct DemotableBlock : public Block {
+        DemotableBlock(const BlockContents& contents, std::string* raw_data, Cache* cache, const Slice& key)
+            : Block(contents), compressed_cache(cache), compressed_key(key.ToString()) {
+            raw.swap(*raw_data);
+        }
+
+        // block的原始数据（压缩后的数据与压缩类型）
+        std::string raw;
+        Cache* const compressed_cache;
+        const std::string compressed_key;
+    };
+
+    // block_cache在释放分片的锁之后才调用deleter，所以这里可以访问compressed_block_cache。
+    // 同时未命中的多个读取可能各自提升同一个block，其他副本已经降级时不再重复放入
+    static void DeleteDemotableBlock(const Slice&, void* value) {
+        DemotableBlock* block = static_cast<DemotableBlock*>(reinterpret_cast<Block*>(value));
+        Cache* cache = block->compressed_cache;
+        Cache::Handle* existing = cache->Lookup(block->compressed_key);
+        if(existing != nullptr) {
+            cache->Release(existing);
+        } else {
+            std::string* raw = new std::string;
+            raw->swap(block->raw);
+            const size_t charge = raw->size();
+            cache->Release(cache->Insert(block->compressed_key, raw, charge, &DeleteCompressedBlock));
+        }
+        delete block;
+    }
+
+    Status Table::ReadBlockContents(const ReadOptions &options, const BlockHandle &handle,
+                                    BlockContents *result, std::string* raw_data) const {
+        Cache* compressed_cache = rep_->options.compressed_block_cache;
+        PersistentCache* persistent_cache = (rep_->persistent_cache_key_prefix.empty() ?
+                                             nullptr : rep_->options.persistent_cache);
+        if(compressed_cache == nullptr && persistent_cache == nullptr) {
+            return ReadBlock(rep_->file, options, handle, result);
+        }
+        char cache_key_buffer[16];
+        EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+        EncodeFixed64(cache_key_buffer + 8, handle.offset());
+        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+        if(compressed_cache != nullptr) {
+            Cache::Handle* cache_handle = compressed_cache->Lookup(key);
+            if(cache_handle != nullptr) {
+                // 命中时只需要解压
+                const std::string& raw = *reinterpret_cast<std::string*>(compressed_cache->Value(cache_handle));
+                Status s = UncompressBlock(raw, result);
+                if(s.ok() && raw_data != nullptr) {
+                    // block将被提升到block_cache，淘汰时再降级回来
+                    raw_data->assign(raw);
+                    compressed_cache->Release(cache_handle);
+                    compressed_cache->Erase(key);
+                } else {
+                    compressed_cache->Release(cache_handle);
+                }
+                return s;
+            }
+        }
+
+        // block的原始数据，用于填充persistent_cache以及在block被block_cache淘汰时降级到compressed_block_cache
+        std::string local_raw;
+        std::string* raw = (raw_data != nullptr ? raw_data : &local_raw);
+        Status s;
+        bool hit = false;
+        std::string persistent_key;
+        if(persistent_cache != nullptr) {
+            persistent_key = rep_->persistent_cache_key_prefix;
+            PutFixed64(&persistent_key, handle.offset());
+            // 查找失败时从文件读取
+            hit = persistent_cache->Lookup(persistent_key, raw).ok() && UncompressBlock(*raw, result).ok();
+        }
+        if(!hit) {
+            s = ReadBlock(rep_->file, options, handle, result, raw);
+            if(s.ok() && persistent_cache != nullptr && options.fill_cache) {
+                // 写入失败只影响之后能否命中
+                persistent_cache->Insert(persistent_key, *raw);
+            }
+        }
+        return s;
+    }
+
+    void Table::SetPersistentCacheKeyPrefix(const Slice &prefix) {
+        rep_->persistent_cache_key_prefix = prefix.ToString();
+    }
+
     // 根据index value获取data block handle
     // 然后根据block handle来构造读取对应data block的iterator并返回该迭代器
     Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice& index_value) {
+        return BlockReader(arg, options, index_value, false, nullptr, false);
+    }
+
+    Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options, const Slice& index_value) {
+        return BlockReader(arg, options, index_value, false, nullptr, true);
+    }
+
+    Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice& index_value,
+                                 bool point_lookup, bool* pinnable, bool high_priority) {
         Table* table = reinterpret_cast<Table*>(arg);
         Cache* block_cache = table->rep_->options.block_cache;
         Block* block = nullptr;
         Cache::Handle* cache_handle = nullptr;
+        // 从文件读取的block的数据是否位于堆上
+        bool heap_data = false;
 
         // 获取要读取的 data block 的 handle
         BlockHandle handle;
@@ -188,29 +369,53 @@ namespace leveldb {
                 if(cache_handle != nullptr) {
                     block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
                 } else {
-                    // 缓存中不存在该data block ，从SSTable文件读取
-                    s = ReadBlock(table->rep_->file, options, handle, &contents);
+                    // 缓存中不存在该data block ，从SSTable文件读取。
+                    // 设置了compressed_block_cache时取回block的原始数据，压缩的block被淘汰时降级到该缓存
+                    Cache* compressed_cache = table->rep_->options.compressed_block_cache;
+                    const bool demote = (compressed_cache != nullptr && compressed_cache != block_cache &&
+                                         options.fill_cache);
+                    std::string raw;
+                    s = table->ReadBlockContents(options, handle, &contents, demote ? &raw : nullptr);
                     if(s.ok()) {
-                        block = new Block(contents);
+                        void (*deleter)(const Slice&, void*) = &DeleteCachedBlock;
+                        size_t charge;
+                        if(demote && contents.cacheable && !raw.empty() && raw.back() != kNoCompression) {
+                            char compressed_key_buffer[16];
+                            EncodeFixed64(compressed_key_buffer, table->rep_->compressed_cache_id);
+                            EncodeFixed64(compressed_key_buffer + 8, handle.offset());
+                            block = new DemotableBlock(contents, &raw, compressed_cache,
+                                                       Slice(compressed_key_buffer, sizeof(compressed_key_buffer)));
+                            charge = block->size() + static_cast<DemotableBlock*>(block)->raw.size();
+                            deleter = &DeleteDemotableBlock;
+                        } else {
+                            block = new Block(contents);
+                            charge = block->size();
+                        }
+                        heap_data = contents.cacheable;
                         // 若需要存到缓存，则将刚读取的data block 存到缓存中
                         if(contents.cacheable && options.fill_cache) {
-                            cache_handle = block_cache->Insert(key, block, block->size(),
-                                                               DeleteCachedBlock);
+                            cache_handle = block_cache->Insert(key, block, charge, deleter,
+                                                               high_priority ? Cache::Priority::kHigh
+                                                                             : Cache::Priority::kLow);
                         }
                     }
                 }
             } else {
                 // 不使用缓存，则直接读取SSTable文件
-                s = ReadBlock(table->rep_->file, options, handle, &contents);
+                s = table->ReadBlockContents(options, handle, &contents);
                 if(s.ok()) {
                     block = new Block(contents);
+                    heap_data = contents.cacheable;
                 }
             }
         }
+        if(pinnable != nullptr) {
+            *pinnable = (cache_handle != nullptr || heap_data);
+        }
         // ======================================= 构造读取该block 的迭代器 =======================================
         Iterator* iter;
         if(block != nullptr) {
-            iter = block->NewIterator(table->rep_->options.comparator);
+            iter = block->NewIterator(table->rep_->options.comparator, point_lookup);
             if(cache_handle == nullptr) {
                 iter->RegisterCleanup(&DeleteBlock, block, nullptr);
             } else {
@@ -223,22 +428,89 @@ namespace leveldb {
         return iter;
     }
 
+    Iterator* Table::NewIndexBlockIterator(const ReadOptions &options) const {
+        if(rep_->index_block != nullptr) {
+            return rep_->index_block->NewIterator(rep_->options.comparator);
+        }
+        // index block与data block一样通过BlockReader读取，总是以高优先级放入block cache
+        std::string handle_value;
+        rep_->index_handle.EncodeTo(&handle_value);
+        ReadOptions opt = options;
+        opt.fill_cache = true;
+        return BlockReader(const_cast<Table*>(this), opt, handle_value, false, nullptr, true);
+    }
+
+    FilterBlockReader* Table::GetFilter(const ReadOptions &options, Cleanable *pinner) const {
+        if(!rep_->cache_meta_blocks) {
+            return rep_->filter;
+        }
+        if(!rep_->has_filter) {
+            return nullptr;
+        }
+        Cache* block_cache = rep_->options.block_cache;
+        char cache_key_buffer[16];
+        EncodeFixed64(cache_key_buffer, rep_->cache_id);
+        EncodeFixed64(cache_key_buffer + 8, rep_->filter_handle.offset());
+        Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+        Cache::Handle* cache_handle = block_cache->Lookup(key);
+        if(cache_handle == nullptr) {
+            ReadOptions opt;
+            opt.verify_checksums = options.verify_checksums || rep_->options.paranoid_checks;
+            BlockContents block;
+            if(!ReadBlockContents(opt, rep_->filter_handle, &block).ok()) {
+                // 读取失败时不进行过滤
+                return nullptr;
+            }
+            CachedFilter* filter = new CachedFilter;
+            filter->reader = new FilterBlockReader(rep_->options.filter_policy, block.data, rep_->full_filter);
+            filter->heap_data = block.heap_allocated ? block.data.data() : nullptr;
+            cache_handle = block_cache->Insert(key, filter, block.data.size(), &DeleteCachedFilter,
+                                               Cache::Priority::kHigh);
+        }
+        pinner->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+        return reinterpret_cast<CachedFilter*>(block_cache->Value(cache_handle))->reader;
+    }
+
+    // 构造遍历index的迭代器。分区索引时，在顶层索引与各个分区上构造两层迭代器，
+    // 分区与data block一样通过BlockReader读取，从而经过block cache，并以高优先级缓存
+    Iterator* Table::NewIndexIterator(const ReadOptions &options) const {
+        Iterator* index_iter = NewIndexBlockIterator(options);
+        if(!rep_->index_partitioned) {
+            return index_iter;
+        }
+        return NewTwoLevelIterator(index_iter, &Table::IndexPartitionReader, const_cast<Table*>(this), options);
+    }
+
     // 构造能读取整个SSTable的迭代器并返回
     Iterator* Table::NewIterator(const ReadOptions &options) const {
+        return NewIterator(options, nullptr);
+    }
+
+    Iterator* Table::NewIterator(const ReadOptions &options, ScanTracker* scan_tracker) const {
         return NewTwoLevelIterator(
-                rep_->index_block->NewIterator(rep_->options.comparator),
+                NewIndexIterator(options),
                 &Table::BlockReader,
                 const_cast<Table*>(this),
-                options
+                options,
+                scan_tracker
                 );
     }
 
     // 在当前SSTable内部进行查找目标key
     Status Table::InternalGet(const ReadOptions &options, const Slice &k, void *arg,
-                              void (*handle_result)(void *, const Slice &, const Slice &)) {
+                              void (*handle_result)(void *, const Slice &, const Slice &, Cleanable *)) {
         Status s;
+        Cleanable filter_pinner;
+        FilterBlockReader* filter = GetFilter(options, &filter_pinner);
+        // full filter不依赖data block，在查找index之前先进行过滤
+        if(filter != nullptr && filter->full_filter()) {
+            if(!filter->KeyMayMatch(k)) {
+                return s;
+            }
+            filter = nullptr;
+        }
         // 先构造index block的迭代器，来定位目标key可能位于的data block
-        Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+        Iterator* iiter = NewIndexIterator(options);
         // 定位data block
         iiter->Seek(k);
         // 成功定位data block
@@ -246,17 +518,19 @@ namespace leveldb {
             // 获取data block的handle
             Slice handle_value = iiter->value();
             // 根据data block的offset获取对应的filter进行过滤
-            FilterBlockReader* filter = rep_->filter;
             BlockHandle handle;
             if(filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
                 !filter->KeyMayMatch(handle.offset(), k)) {
                 // filter没有匹配到，pass
             } else {
                 // filter指示可能存在，进行查找
-                Iterator* block_iter = BlockReader(this, options, iiter->value());
+                bool pinnable = false;
+                Iterator* block_iter = BlockReader(this, options, iiter->value(), true, &pinnable, false);
                 block_iter->Seek(k);
                 if(block_iter->Valid()) {
-                    (*handle_result)(arg, block_iter->key(), block_iter->value());
+                    // block_iter的cleanup函数负责释放block，将其交给handle_result即可在不拷贝的情况下引用value
+                    (*handle_result)(arg, block_iter->key(), block_iter->value(),
+                                     pinnable ? block_iter : nullptr);
                 }
                 s = block_iter->status();
                 delete block_iter;
@@ -269,10 +543,99 @@ namespace leveldb {
         return s;
     }
 
+    Status Table::InternalMultiGet(const ReadOptions &options, const Slice *keys, int n, void *arg,
+                                   void (*handle_result)(void *, int, const Slice &, const Slice &)) {
+        Status s;
+        const Comparator* cmp = rep_->options.comparator;
+        Cleanable filter_pinner;
+        FilterBlockReader* filter = GetFilter(options, &filter_pinner);
+        // full filter在查找index之前批量过滤所有key
+        std::unique_ptr<bool[]> may_match;
+        if(filter != nullptr && filter->full_filter()) {
+            may_match.reset(new bool[n]);
+            filter->KeysMayMatch(n, keys, may_match.get());
+            filter = nullptr;
+        }
+        Iterator* iiter = NewIndexIterator(options);
+        // 当前打开的data block的迭代器及该block的偏移
+        Iterator* block_iter = nullptr;
+        uint64_t block_offset = 0;
+        for(int i = 0; i < n && s.ok(); i++) {
+            if(may_match != nullptr && !may_match[i]) {
+                continue;
+            }
+            // keys有序，只有当前key超出了index迭代器所指data block的范围时才需要重新定位
+            if(!iiter->Valid() || cmp->Compare(keys[i], iiter->key()) > 0) {
+                iiter->Seek(keys[i]);
+                if(!iiter->Valid()) {
+                    // 剩余的key都大于该SSTable中的最大key
+                    break;
+                }
+            }
+            Slice handle_value = iiter->value();
+            BlockHandle handle;
+            const bool decoded = handle.DecodeFrom(&handle_value).ok();
+            if(filter != nullptr && decoded && !filter->KeyMayMatch(handle.offset(), keys[i])) {
+                // filter没有匹配到，pass
+                continue;
+            }
+            // 与上一个key不在同一个data block中时才读取新的block
+            if(block_iter == nullptr || !decoded || handle.offset() != block_offset) {
+                delete block_iter;
+                block_iter = BlockReader(this, options, iiter->value(), true, nullptr, false);
+                block_offset = handle.offset();
+            }
+            block_iter->Seek(keys[i]);
+            if(block_iter->Valid()) {
+                (*handle_result)(arg, i, block_iter->key(), block_iter->value());
+            }
+            s = block_iter->status();
+        }
+        delete block_iter;
+        if(s.ok()) {
+            s = iiter->status();
+        }
+        delete iiter;
+        return s;
+    }
+
+    bool Table::PrefixMayMatch(const ReadOptions &options, const Slice &target) const {
+        const SliceTransform* prefix_extractor = rep_->options.prefix_extractor;
+        if(!rep_->prefix_filtering || !prefix_extractor->InDomain(target)) {
+            return true;
+        }
+        Cleanable filter_pinner;
+        FilterBlockReader* filter = GetFilter(options, &filter_pinner);
+        if(filter == nullptr) {
+            return true;
+        }
+        const Slice prefix = prefix_extractor->Transform(target);
+        if(filter->full_filter()) {
+            return filter->KeyMayMatch(prefix);
+        }
+        // 具有该前缀且不小于target的key只可能位于index中第一个不小于target的data block中：
+        // 若该block中没有该前缀的key，则其最后一个key大于所有具有该前缀的key，之后的block也是如此
+        bool may_match = true;
+        Iterator* iiter = NewIndexIterator(options);
+        iiter->Seek(target);
+        if(iiter->Valid()) {
+            Slice handle_value = iiter->value();
+            BlockHandle handle;
+            if(handle.DecodeFrom(&handle_value).ok()) {
+                may_match = filter->KeyMayMatch(handle.offset(), prefix);
+            }
+        } else if(iiter->status().ok()) {
+            // 所有key都小于target
+            may_match = false;
+        }
+        delete iiter;
+        return may_match;
+    }
+
     // 定位目标key的位置
     uint64_t  Table::ApproximateOffset(const Slice &key) const {
         // 构造index block的迭代器
-        Iterator* index_iter = rep_->index_block->NewIterator(rep_->options.comparator);
+        Iterator* index_iter = NewIndexIterator(ReadOptions());
         // 定位data block
         index_iter->Seek(key);
         uint64_t result;
@@ -5,11 +5,14 @@
 #include "leveldb/table_builder.h"
 
 #include <cassert>
+#include <utility>
+#include <vector>
 
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -30,10 +33,12 @@ namespace leveldb {
                 closed(false),
                 filter_block(opt.filter_policy == nullptr
                                     ? nullptr
-                                    : new FilterBlockBuilder(opt.filter_policy)),
+                                    : new FilterBlockBuilder(opt.filter_policy, opt.full_filter,
+                                                             opt.prefix_extractor)),
                 pending_index_entry(false) {
 
             index_block_options.block_restart_interval = 1;
+            index_block_options.data_block_hash_index = false;
         }
 
         // 当前data block的option
@@ -65,6 +70,8 @@ namespace leveldb {
         BlockHandle pending_handle;
         // 临时存储压缩后的data block
         std::string compressed_output;
+        // 分区索引时已经切分出来的index分区：分区中最后一个key以及分区的内容，在Finish()时写入SSTable
+        std::vector<std::pair<std::string, std::string>> index_partitions;
     };
 
     TableBuilder::TableBuilder(const Options& options, WritableFile* file)
@@ -88,6 +95,7 @@ namespace leveldb {
         rep_->options = options;
         rep_->index_block_options = options;
         rep_->index_block_options.block_restart_interval = 1;
+        rep_->index_block_options.data_block_hash_index = false;
         return Status::OK();
     }
 
@@ -109,12 +117,9 @@ namespace leveldb {
             assert(r->data_block.empty());
             // 调整last_key
             r->options.comparator->FindShortestSeparator(&r->last_key, key);
-            std::string handle_encoding;
-            // 将data block的handle压缩存储到handle_encoding
-            r->pending_handle.EncodeTo(&handle_encoding);
             // 将上一个data block的handle信息存到index block，该信息也是一个KV映射，
             // 其中key是当前last_key，value是将该data block的handle序列化后的字符串。
-            r->index_block.Add(r->last_key, Slice(handle_encoding));
+            AddIndexEntry(r->last_key, r->pending_handle);
             r->pending_index_entry = false;
         }
 
@@ -160,8 +165,28 @@ namespace leveldb {
         }
     }
 
+    void TableBuilder::AddIndexEntry(const Slice &key, const BlockHandle &handle) {
+        Rep* r = rep_;
+        std::string handle_encoding;
+        // 将data block的handle压缩存储到handle_encoding
+        handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(key, Slice(handle_encoding));
+        // 分区写满后切分出来，分区中最后一个key即为顶层索引中该分区的key
+        if(r->options.partition_index &&
+           r->index_block.CurrentSizeEstimate() >= r->options.index_partition_size) {
+            r->index_partitions.emplace_back(key.ToString(), r->index_block.Finish().ToString());
+            r->index_block.Reset();
+        }
+    }
+
     // 对block数据进行最终处理（压缩），然后调用WriteRawBlock函数写入SSTable
     void TableBuilder::WriteBlock(BlockBuilder *block, BlockHandle *handle) {
+        // 获取完整的完成写入的block数据
+        WriteBlock(block->Finish(), handle);
+        block->Reset();
+    }
+
+    void TableBuilder::WriteBlock(const Slice &raw, BlockHandle *handle) {
         // File包含一系列的block ，每个block由以下部分组成：
         //    block_data: uint8[n]
         //    type: uint8
@@ -169,8 +194,6 @@ namespace leveldb {
 
         assert(ok());
         Rep* r = rep_;
-        // 获取完整的完成写入的block数据
-        Slice raw = block->Finish();
 
         Slice block_contents;
         CompressionType type = r->options.compression;
@@ -196,7 +219,6 @@ namespace leveldb {
 
         WriteRawBlock(block_contents, type, handle);
         r->compressed_output.clear();
-        block->Reset();
     }
 
     // 将处理完成的block数据写入SSTable，并将block的信息（位置偏移和大小）保存在*handle中。
@@ -251,12 +273,15 @@ namespace leveldb {
         // 写入meta index block
         // meta index block 存的是 filter.name -> filter handle的映射
         if(ok()) {
-            // 将该SSTable的options构建一个空的meta index block
-            BlockBuilder meta_index_block(&r->options);
+            // 将该SSTable的options构建一个空的meta index block，其key不是internal key，不能构建hash索引
+            Options meta_index_options = r->options;
+            meta_index_options.data_block_hash_index = false;
+            meta_index_options.comparator = BytewiseComparator();
+            BlockBuilder meta_index_block(&meta_index_options);
             if(r->filter_block != nullptr) {
                 // 加入"filter.Name"到filter data位置的映射，本映射便为meta index block的内容
                 // 构造key
-                std::string key = "filter.";
+                std::string key = r->filter_block->full_filter() ? kFullFilterKeyPrefix : kFilterKeyPrefix;
                 key.append(r->options.filter_policy->Name());
                 // 构造value
                 std::string handle_encoding;
@@ -264,6 +289,14 @@ namespace leveldb {
                 // 写入meta index block
                 meta_index_block.Add(key, handle_encoding);
             }
+            if(r->options.partition_index) {
+                // 标记index block是分区索引的顶层索引
+                meta_index_block.Add(kPartitionedIndexKey, Slice());
+            }
+            if(r->filter_block != nullptr && r->options.prefix_extractor != nullptr) {
+                // 记录filter中的前缀由哪个提取器生成
+                meta_index_block.Add(kPrefixExtractorKey, r->options.prefix_extractor->Name());
+            }
             // meta index block还需进一步处理，调用WriteBlock函数写入
             WriteBlock(&meta_index_block, &metaindex_block_handle);
         }
@@ -273,12 +306,30 @@ namespace leveldb {
             // 将最后一个data block的信息存入index block
             if(r->pending_index_entry) {
                 r->options.comparator->FindShortSuccessor(&r->last_key);
-                std::string handle_encoding;
-                r->pending_handle.EncodeTo(&handle_encoding);
-                r->index_block.Add(r->last_key, Slice(handle_encoding));
+                AddIndexEntry(r->last_key, r->pending_handle);
                 r->pending_index_entry = false;
             }
-            WriteBlock(&r->index_block, &index_block_handle);
+            if(r->options.partition_index) {
+                // 分区索引：先写入各个分区，再写入以各分区最后一个key为key、分区handle为value的顶层索引，
+                // footer中的index handle指向顶层索引
+                if(!r->index_block.empty()) {
+                    r->index_partitions.emplace_back(r->last_key, r->index_block.Finish().ToString());
+                    r->index_block.Reset();
+                }
+                BlockBuilder top_level_index(&r->index_block_options);
+                for(size_t i = 0; i < r->index_partitions.size() && ok(); i++) {
+                    BlockHandle partition_handle;
+                    WriteBlock(r->index_partitions[i].second, &partition_handle);
+                    std::string handle_encoding;
+                    partition_handle.EncodeTo(&handle_encoding);
+                    top_level_index.Add(r->index_partitions[i].first, Slice(handle_encoding));
+                }
+                if(ok()) {
+                    WriteBlock(&top_level_index, &index_block_handle);
+                }
+            } else {
+                WriteBlock(&r->index_block, &index_block_handle);
+            }
         }
         // 写入footer
         // footer存了两个重要的block handle，也即meta index block handle 和 index block handle
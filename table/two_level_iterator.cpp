@@ -18,7 +18,7 @@ namespace leveldb {
         class TwoLevelIterator : public Iterator {
         public:
             TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                             void* arg, const ReadOptions& options);
+                             void* arg, const ReadOptions& options, ScanTracker* scan_tracker);
             ~TwoLevelIterator() override;
 
             void Seek(const Slice& target) override;
@@ -60,7 +60,10 @@ namespace leveldb {
 
             BlockFunction block_function_;
             void* arg_;
-            const ReadOptions options_;
+            ReadOptions options_;
+            // 调用方指定的fill_cache
+            const bool fill_cache_;
+            ScanTracker* const scan_tracker_;
             Status status_;
             IteratorWrapper index_iter_;
             IteratorWrapper data_iter_;
@@ -69,10 +72,13 @@ namespace leveldb {
 
         TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                            BlockFunction block_function, void* arg,
-                                           const ReadOptions& options)
+                                           const ReadOptions& options,
+                                           ScanTracker* scan_tracker)
                                            : block_function_(block_function),
                                              arg_(arg),
                                              options_(options),
+                                             fill_cache_(options.fill_cache),
+                                             scan_tracker_(scan_tracker),
                                              index_iter_(index_iter),
                                              data_iter_(nullptr) {}
 
@@ -184,7 +190,11 @@ namespace leveldb {
                 if(data_iter_.iter() != nullptr && handle.compare(data_block_handle) == 0) {
                     // handle相同，data block iterator不需要改变
                 } else {
-                    // 根据handle获取data block的读取迭代器
+                    // 根据handle获取data block的读取迭代器，扫描读取的block达到上限后不再放入block cache
+                    if(scan_tracker_ != nullptr) {
+                        options_.fill_cache = fill_cache_ && scan_tracker_->FillCache();
+                        scan_tracker_->AddBlock();
+                    }
                     Iterator* iter = (*block_function_)(arg_, options_, handle);
                     data_block_handle.assign(handle.data(), handle.size());
                     // 设置data block的读取迭代器
@@ -197,8 +207,8 @@ namespace leveldb {
 
     Iterator* NewTwoLevelIterator(Iterator* index_iter,
                                   BlockFunction block_function, void* arg,
-                                  const ReadOptions& options) {
-        return new TwoLevelIterator(index_iter, block_function, arg, options);
+                                  const ReadOptions& options, ScanTracker* scan_tracker) {
+        return new TwoLevelIterator(index_iter, block_function, arg, options, scan_tracker);
     }
 
 
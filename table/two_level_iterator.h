@@ -10,14 +10,34 @@
 namespace leveldb {
 
     struct ReadOptions;
+
+    // 一个DB迭代器所读取的所有SSTable共享的扫描统计，用于实现Options::scan_fill_cache_limit。
+    // DB迭代器每次Seek时调用Reset()，其下各个SSTable的迭代器每读取一个data block调用一次AddBlock()，
+    // 因此跨越多个文件的扫描也会被识别出来。自上次Seek以来读取的data block达到limit后，
+    // 之后读取的block不再放入block cache。只在持有它的DB迭代器所在的线程中使用
+    class ScanTracker {
+    public:
+        explicit ScanTracker(int limit) : limit_(limit), blocks_(0) {}
+
+        void Reset() { blocks_ = 0; }
+        void AddBlock() { blocks_++; }
+        bool FillCache() const { return blocks_ < limit_; }
+
+    private:
+        const int limit_;
+        int blocks_;
+    };
+
     // 返回一个双层迭代器。
     // 一个双层迭代器包含一个索引迭代器，索引迭代器的值指向一系列data block，
     // 每个data block包含一系列KV对。
     // 返回的双层迭代器会对所有data block中的KV对按照data block的顺序进行级联拼接。
+    // 若scan_tracker不为nullptr，则每读取一个block都计入其中，其FillCache()为false时
+    // 传给block_function的options中fill_cache也为false
     Iterator* NewTwoLevelIterator(
             Iterator* index_iter,
             Iterator* (*block_function)(void* arg, const ReadOptions& options, const Slice& index_value) ,
-            void *arg, const ReadOptions& options);
+            void *arg, const ReadOptions& options, ScanTracker* scan_tracker = nullptr);
 
 } // end namespace leveldb
 
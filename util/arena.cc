@@ -1,4 +1,6 @@
 #include "util/arena.h"
+
+#include <thread>
 /**
  * @brief C++提供new/delete来管理内存的申请和释放，但是对于小对象来说，直接使用new/delete代价比较大，要付出
  *        额外的空间和时间，性价比不高。另外，也需要避免多次申请和释放引起的内存碎片，一旦碎片到达一定程度，即使
@@ -16,7 +18,7 @@ namespace leveldb {
     // 定义block大小为4KB ( 4096 = 1024 * 4)
     static const int kBlockSize = 4096;
 
-    Arena::Arena() : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+    Arena::Arena() : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0), spin_locked_(false) {}
     Arena::~Arena() {
         // 释放申请的内存空间
         for(size_t i = 0; i < blocks_.size(); i++) {
@@ -79,6 +81,29 @@ namespace leveldb {
     } // end AllocateAligned
 
 
+    void Arena::SpinLock() {
+        // 先用exchange尝试加锁，失败后只读等待锁被释放，避免反复写同一cache line
+        while(spin_locked_.exchange(true, std::memory_order_acquire)) {
+            while(spin_locked_.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    char* Arena::AllocateConcurrently(size_t bytes) {
+        SpinLock();
+        char* result = Allocate(bytes);
+        SpinUnlock();
+        return result;
+    }
+
+    char* Arena::AllocateAlignedConcurrently(size_t bytes) {
+        SpinLock();
+        char* result = AllocateAligned(bytes);
+        SpinUnlock();
+        return result;
+    }
+
     // 申请一个大小为block_bytes的内存块
     char* Arena::AllocateNewBlock(size_t block_bytes) {
         // 申请一个大小为block_bytes的内存块
@@ -25,6 +25,12 @@ namespace leveldb {
         // 使用 malloc 提供的正常对齐来保证内存分配
         char* AllocateAligned(size_t bytes);
 
+        // 以上两个分配函数的线程安全版本，供多个线程同时向同一个Arena申请内存时使用
+        // （例如多个writer并发写同一个memtable）。内部用自旋锁保护分配状态，
+        // 调用者需保证它们不会与非并发版本的分配函数同时被调用。
+        char* AllocateConcurrently(size_t bytes);
+        char* AllocateAlignedConcurrently(size_t bytes);
+
         // 估计Arena分配的数据的总内存使用量
         // 该函数返回当前分配给Arena对象的所有内存空间大小和所有指向内存块的指针大小之和。
         size_t MemoryUsage() const {
@@ -35,6 +41,9 @@ namespace leveldb {
         // 分配函数
         char* AllocateFallback(size_t bytes); // 直接分配内存
         char* AllocateNewBlock(size_t block_bytes); // 分配对齐的内存空间
+        // 并发分配时使用的自旋锁，临界区只是几次指针运算，因此不必使用互斥锁
+        void SpinLock();
+        void SpinUnlock() { spin_locked_.store(false, std::memory_order_release); }
         // 分配状态
         char* alloc_ptr_; // 指向当前内存块未分配内存的起始地址的指针
         size_t alloc_bytes_remaining_; // 记录当前内存块未分配内存的大小，单位为字节
@@ -47,6 +56,9 @@ namespace leveldb {
         // TODO(costan): This member is accessed via atomics, but the others are
         //               accessed without any locking. Is this OK?
         std::atomic<size_t> memory_usage_; // 原子变量，记录当前对象的内存总量
+
+        // 自旋锁状态，仅被并发版本的分配函数使用
+        std::atomic<bool> spin_locked_;
     };
 
 
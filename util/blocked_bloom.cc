@@ -0,0 +1,227 @@
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/hash.h"
+
+// 只在x86-64的GCC/Clang下提供AVX2探测，通过target属性编译并在运行时检测CPU是否支持，
+// 因此不需要为整个库打开-mavx2，其他平台使用标量实现
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_BLOCKED_BLOOM_AVX2 1
+#include <immintrin.h>
+#else
+#define LEVELDB_BLOCKED_BLOOM_AVX2 0
+#endif
+
+// Blocked bloom filter的格式：
+//      [cache line 0][cache line 1]...[cache line num_lines-1][k]
+// 每个cache line为64字节（512 bit），一个key的所有k个bit都位于同一个cache line中，
+// 最后一个字节为探测次数k。
+//
+// 对一个key计算32位哈希值h，用h选择cache line，再用h打散后的值h2生成k个探测位置：
+// 第j次探测的位置为 (h2 * c^(j+1)) >> 23，即cache line内的9位偏移，其中c为黄金分割常数。
+// 标量与AVX2实现使用相同的探测序列，因此二者生成与读取的filter完全相同。
+
+namespace leveldb {
+    namespace {
+        // 一个cache line的字节数及bit数
+        static const size_t kLineBytes = 64;
+        static const uint32_t kLineBits = kLineBytes * 8;
+        // 生成探测序列的乘数
+        static const uint32_t kProbeMultiplier = 0x9e3779b9;
+
+        static uint32_t BlockedBloomHash(const Slice& key) {
+            return Hash(key.data(), key.size(), 0xbc9f1d34);
+        }
+
+        // 将h映射到[0, n)，比取模更快且使用的是h的高位
+        static inline uint32_t FastRange32(uint32_t h, uint32_t n) {
+            return static_cast<uint32_t>((static_cast<uint64_t>(h) * n) >> 32);
+        }
+
+        // 打散h得到探测序列的种子，使其与选择cache line所用的高位不相关
+        static inline uint32_t ProbeSeed(uint32_t h) {
+            h ^= h >> 16;
+            h *= 0x85ebca6b;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35;
+            h ^= h >> 16;
+            return h;
+        }
+
+        static inline void AddHash(uint32_t h, uint32_t num_lines, int k, char* data) {
+            char* line = data + FastRange32(h, num_lines) * kLineBytes;
+            uint32_t h2 = ProbeSeed(h);
+            for(int j = 0; j < k; j++) {
+                h2 *= kProbeMultiplier;
+                const uint32_t bitpos = h2 >> 23;
+                line[bitpos >> 3] |= static_cast<char>(1 << (bitpos & 7));
+            }
+        }
+
+        static inline bool ScalarHashMayMatch(uint32_t h2, int k, const char* line) {
+            for(int j = 0; j < k; j++) {
+                h2 *= kProbeMultiplier;
+                const uint32_t bitpos = h2 >> 23;
+                if((line[bitpos >> 3] & (1 << (bitpos & 7))) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+#if LEVELDB_BLOCKED_BLOOM_AVX2
+        // 一次进行8次探测：8个lane分别计算h2 * c^(j+1)，从cache line的16个32位字中取出对应的字并检查相应bit。
+        // cache line按小端序解释为16个uint32_t，与标量实现逐字节的bit编号一致
+        __attribute__((target("avx2")))
+        static bool Avx2HashMayMatch(uint32_t h2, int k, const char* line) {
+            // c^1 ... c^8
+            const __m256i multipliers = _mm256_setr_epi32(
+                    0x9e3779b9, 0xe35e67b1, 0x734297e9, 0x35fbe861,
+                    0xdeb7c719, 0x448b211, 0x3459b749, 0xab25f4c1);
+            // 每轮之后乘以c^8，继续下一组8次探测
+            const uint32_t multiplier_8 = 0xab25f4c1;
+            const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line));
+            const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + 32));
+            const __m256i ones = _mm256_set1_epi32(1);
+            const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            for(;;) {
+                const __m256i hashes = _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(h2)), multipliers);
+                // 9位的bit偏移：高4位为字的下标，低5位为字内的bit
+                const __m256i bitpos = _mm256_srli_epi32(hashes, 23);
+                const __m256i word_index = _mm256_srli_epi32(bitpos, 5);
+                // permutevar8x32只使用下标的低3位，第4位用于在lo与hi之间选择
+                const __m256i from_lo = _mm256_permutevar8x32_epi32(lo, word_index);
+                const __m256i from_hi = _mm256_permutevar8x32_epi32(hi, word_index);
+                const __m256i use_hi = _mm256_cmpgt_epi32(word_index, _mm256_set1_epi32(7));
+                const __m256i words = _mm256_blendv_epi8(from_lo, from_hi, use_hi);
+                const __m256i bit = _mm256_sllv_epi32(ones, _mm256_and_si256(bitpos, _mm256_set1_epi32(31)));
+                // 对应bit为0的lane
+                const __m256i missing = _mm256_cmpeq_epi32(_mm256_and_si256(words, bit), _mm256_setzero_si256());
+                // 只检查前k个lane
+                const __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(k), lane_index);
+                if(!_mm256_testz_si256(missing, valid)) {
+                    return false;
+                }
+                if(k <= 8) {
+                    return true;
+                }
+                k -= 8;
+                h2 *= multiplier_8;
+            }
+        }
+
+        static bool CpuHasAvx2() {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        }
+#endif
+
+        class BlockedBloomFilterPolicy : public FilterPolicy {
+            public:
+            explicit BlockedBloomFilterPolicy(int bits_per_key) : bits_per_key_(bits_per_key) {
+                // 与BloomFilterPolicy相同，k取 bits_per_key * ln(2)
+                k_ = static_cast<int>(bits_per_key * 0.69);
+                if(k_ < 1) k_ = 1;
+                if(k_ > 30) k_ = 30;
+#if LEVELDB_BLOCKED_BLOOM_AVX2
+                use_avx2_ = CpuHasAvx2();
+#else
+                use_avx2_ = false;
+#endif
+            }
+
+            const char* Name() const override { return "leveldb.BlockedBloomFilter"; }
+
+            void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+                // filter的大小向上取整到cache line的整数倍，至少一个cache line
+                size_t bits = static_cast<size_t>(n) * bits_per_key_;
+                size_t num_lines = (bits + kLineBits - 1) / kLineBits;
+                if(num_lines < 1) num_lines = 1;
+
+                const size_t init_size = dst->size();
+                dst->resize(init_size + num_lines * kLineBytes, 0);
+                dst->push_back(static_cast<char>(k_));
+                char* array = &(*dst)[init_size];
+                for(int i = 0; i < n; i++) {
+                    AddHash(BlockedBloomHash(keys[i]), static_cast<uint32_t>(num_lines), k_, array);
+                }
+            }
+
+            bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+                uint32_t num_lines;
+                int k;
+                if(!DecodeFilter(filter, &num_lines, &k)) {
+                    // 过短或无法识别的编码（可能是新的编码），视为匹配。
+                    // 由0个key生成的filter仍有一个全0的cache line，会在下面的探测中返回false
+                    return true;
+                }
+                const uint32_t h = BlockedBloomHash(key);
+                return HashMayMatch(h, filter.data() + FastRange32(h, num_lines) * kLineBytes, k);
+            }
+
+            // 先计算所有key的哈希值并预取各自的cache line，再逐个探测，使多个key的cache miss相互重叠
+            void KeysMayMatch(int n, const Slice* keys, const Slice& filter, bool* may_match) const override {
+                uint32_t num_lines;
+                int k;
+                if(!DecodeFilter(filter, &num_lines, &k)) {
+                    for(int i = 0; i < n; i++) {
+                        may_match[i] = true;
+                    }
+                    return;
+                }
+                // 分批处理，限制同时在途的预取数量
+                static const int kBatchSize = 32;
+                uint32_t hashes[kBatchSize];
+                const char* lines[kBatchSize];
+                for(int start = 0; start < n; start += kBatchSize) {
+                    const int batch = (n - start < kBatchSize) ? (n - start) : kBatchSize;
+                    for(int i = 0; i < batch; i++) {
+                        hashes[i] = BlockedBloomHash(keys[start + i]);
+                        lines[i] = filter.data() + FastRange32(hashes[i], num_lines) * kLineBytes;
+#if defined(__GNUC__) || defined(__clang__)
+                        __builtin_prefetch(lines[i]);
+#endif
+                    }
+                    for(int i = 0; i < batch; i++) {
+                        may_match[start + i] = HashMayMatch(hashes[i], lines[i], k);
+                    }
+                }
+            }
+
+            private:
+            // 解析filter的尾部，得到cache line的数量与探测次数k，格式无法识别时返回false
+            static bool DecodeFilter(const Slice& filter, uint32_t* num_lines, int* k) {
+                const size_t len = filter.size();
+                if(len < kLineBytes + 1 || (len - 1) % kLineBytes != 0) {
+                    return false;
+                }
+                *k = static_cast<unsigned char>(filter[len - 1]);
+                if(*k < 1 || *k > 30) {
+                    return false;
+                }
+                *num_lines = static_cast<uint32_t>((len - 1) / kLineBytes);
+                return true;
+            }
+
+            bool HashMayMatch(uint32_t h, const char* line, int k) const {
+                const uint32_t h2 = ProbeSeed(h);
+#if LEVELDB_BLOCKED_BLOOM_AVX2
+                if(use_avx2_) {
+                    return Avx2HashMayMatch(h2, k, line);
+                }
+#endif
+                return ScalarHashMayMatch(h2, k, line);
+            }
+
+            // 平均每个key占用的bit
+            size_t bits_per_key_;
+            // 每个key的探测次数
+            int k_;
+            // 当前CPU是否支持AVX2
+            bool use_avx2_;
+        };
+    } // end anonymous namespace
+
+    const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+        return new BlockedBloomFilterPolicy(bits_per_key);
+    }
+} // end namespace leveldb
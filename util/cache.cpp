@@ -4,9 +4,11 @@
 
 #include "leveldb/cache.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -32,6 +34,19 @@ namespace leveldb {
         // - LRU: 包含客户端当前未引用的item，按LRU排序。（冷数据）
         //
         // 当Ref()和Unref()方法检测到一个元素获得或丢失掉其唯一的外部引用时，元素会在这两个链表之间移动，。
+        //
+        // LRU链表分为前后两段：前段为低优先级池，后段为高优先级池，lru_low_pri_指向低优先级池中最新的节点。
+        // 低优先级的item插入到低优先级池的尾部，高优先级的item插入到整个链表的尾部，淘汰从链表头部开始，
+        // 因此高优先级池中的item在低优先级池被淘汰空之后才会被淘汰。
+        // 高优先级池的大小超过high_pri_pool_capacity_时，其中最早的item会被移入低优先级池。
+        //
+        // 启用TinyLFU准入策略时，每个分片用一个FrequencySketch统计各个key近期被Lookup()的次数。
+        // 插入一个新的低优先级item需要淘汰旧的item时，只有其访问频率高于LRU链表头部（即将被淘汰）的item
+        // 才会被放入缓存，否则Insert()返回一个不在缓存中的节点，被释放时直接删除。
+        // 这样扫描读取的只被访问一次的block不会挤出频繁访问的block。
+        //
+        // 引用计数变为0的节点先被放入to_free_链表，在释放mutex_之后才调用其deleter，
+        // 因此deleter中可以访问其他Cache（例如将淘汰的block降级到另一级缓存），不会与分片的锁互相嵌套。
 
         // entry是可变长度的堆分配的结构。entry保存在按访问时间排序的循环双向链表中。
         struct LRUHandle {
@@ -49,6 +64,10 @@ namespace leveldb {
             size_t key_length;
             // entry是否在缓存中
             bool in_cache;
+            // 插入时是否指定为高优先级
+            bool is_high_pri;
+            // 是否位于LRU链表的高优先级池中
+            bool in_high_pri_pool;
             // 引用数量，包括缓存的引用
             uint32_t refs;
             // key的哈希值，用于快速分片和比较
@@ -101,6 +120,9 @@ namespace leveldb {
                 return old;
             }
 
+            // 返回table中缓存元素的数量
+            uint32_t Size() const { return elems_; }
+
             // 从缓存中移除指定的key/hash项，并返回指向该缓存项的指针
             LRUHandle* Remove(const Slice& key, uint32_t hash) {
                 // 找到key的位置
@@ -167,17 +189,115 @@ namespace leveldb {
             }
         };
 
+        // TinyLFU准入策略使用的访问频率统计，为一个count-min sketch：
+        // kDepth行计数器，key的hash在每一行中映射到一个计数器，其访问频率取这些计数器中的最小值，
+        // 计数器的最大值为kMaxCount。记录的访问次数达到每行计数器数量的2倍（约为缓存项数量的10倍）时
+        // 所有计数器减半，因此统计的是近期的访问频率，曾经的热点数据不会一直占据缓存。
+        class FrequencySketch {
+        public:
+            FrequencySketch() : mask_(0), additions_(0), sample_size_(0) {}
+
+            // 保证每一行的计数器数量不少于缓存项数量的4倍，以减少冲突。
+            // 计数器的位置取乘积的低位，扩容后位置j的计数器对应扩容前位置(j & 旧的mask_)的计数器，
+            // 因此将旧的计数复制过去即可保留已有的统计
+            void EnsureCapacity(size_t entries) {
+                const size_t old_width = table_.empty() ? 0 : mask_ + 1;
+                if(old_width != 0 && entries * 4 <= old_width) {
+                    return;
+                }
+                size_t width = kMinWidth;
+                while(width < entries * 4) {
+                    width *= 2;
+                }
+                std::vector<uint8_t> table(width * kDepth, 0);
+                if(old_width != 0) {
+                    for(int i = 0; i < kDepth; i++) {
+                        for(size_t j = 0; j < width; j++) {
+                            table[i * width + j] = table_[i * old_width + (j & mask_)];
+                        }
+                    }
+                }
+                table_.swap(table);
+                mask_ = width - 1;
+                sample_size_ = width * 2;
+            }
+
+            // 记录一次访问
+            void Increment(uint32_t hash) {
+                bool added = false;
+                for(int i = 0; i < kDepth; i++) {
+                    uint8_t& counter = table_[Index(hash, i)];
+                    if(counter < kMaxCount) {
+                        counter++;
+                        added = true;
+                    }
+                }
+                if(added && ++additions_ >= sample_size_) {
+                    Reset();
+                }
+            }
+
+            // 返回估计的访问频率
+            int Frequency(uint32_t hash) const {
+                int frequency = kMaxCount;
+                for(int i = 0; i < kDepth; i++) {
+                    frequency = std::min<int>(frequency, table_[Index(hash, i)]);
+                }
+                return frequency;
+            }
+
+        private:
+            static const int kDepth = 4;
+            static const uint8_t kMaxCount = 15;
+            static const size_t kMinWidth = 64;
+
+            // 第i行中hash对应的计数器的位置。
+            // 取乘积的高32位，使得每一行的位置都与hash的所有位相关，各行之间相互独立
+            size_t Index(uint32_t hash, int i) const {
+                static const uint64_t kSeeds[kDepth] = {
+                        0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full,
+                        0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull};
+                const uint64_t h = (static_cast<uint64_t>(hash) * kSeeds[i]) >> 32;
+                return i * (mask_ + 1) + (h & mask_);
+            }
+
+            // 所有计数器减半
+            void Reset() {
+                for(uint8_t& counter : table_) {
+                    counter >>= 1;
+                }
+                additions_ /= 2;
+            }
+
+            std::vector<uint8_t> table_;
+            size_t mask_;
+            // 上次减半以来记录的访问次数
+            size_t additions_;
+            size_t sample_size_;
+        };
+
         // LRUCache是ShardedLRUCache分片缓存的一个分片
         class LRUCache {
         public:
             LRUCache();
             ~LRUCache();
 
+            // 需要在SetHighPriorityPoolRatio()之前调用
             void SetCapacity(size_t capacity) { capacity_ = capacity; }
+            void SetHighPriorityPoolRatio(double ratio) {
+                high_pri_pool_capacity_ = static_cast<size_t>(capacity_ * ratio);
+            }
+            // 启用TinyLFU准入策略
+            void EnableAdmissionPolicy() {
+                MutexLock l(&mutex_);
+                admission_policy_ = true;
+                sketch_.EnsureCapacity(0);
+            }
 
             Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                                   size_t charge,
-                                  void (*deleter)(const Slice& key, void* value));
+                                  void (*deleter)(const Slice& key, void* value),
+                                  Cache::Priority priority);
 
             Cache::Handle* Lookup(const Slice& key, uint32_t hash);
 
@@ -192,11 +312,25 @@ namespace leveldb {
         private:
             void LRU_Remove(LRUHandle* e);
             void LRU_Append(LRUHandle* list, LRUHandle* e);
+            // 按照e的优先级将其插入lru_链表
+            void LRU_Insert(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 高优先级池超出容量时，将其中最早的节点移入低优先级池
+            void MaintainPoolSize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 根据准入策略判断是否将新的缓存项放入缓存。
+            // 高优先级的缓存项、替换已有key的缓存项以及不会引起淘汰的缓存项总是放入缓存
+            bool Admit(const Slice& key, uint32_t hash, size_t charge, Cache::Priority priority)
+                EXCLUSIVE_LOCKS_REQUIRED(mutex_);
             void Ref(LRUHandle* e);
             void Unref(LRUHandle* e);
             bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 取出to_free_链表，由调用者在释放mutex_之后交给FreeHandles()
+            LRUHandle* TakeFreeList() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 调用链表中各个节点的deleter并释放节点
+            static void FreeHandles(LRUHandle* list);
 
             size_t capacity_;
+            // 高优先级池的容量
+            size_t high_pri_pool_capacity_;
             mutable port::Mutex mutex_;
             // 以下变量使用线程安全注解，GUARDED_BY(mutex_) 表示这些成员变量
             // 受mutex_保护
@@ -204,13 +338,25 @@ namespace leveldb {
             // LRU链表的头节点，lru_.prev始终指向最新的节点，
             // lru_.next指向最早的节点，其中的每个LRUHandle节点的refs == 1，in_cache == true
             LRUHandle lru_ GUARDED_BY(mutex_);
+            // 低优先级池中最新的节点，低优先级池为空时指向lru_
+            LRUHandle* lru_low_pri_ GUARDED_BY(mutex_);
+            // 高优先级池中的节点占用的缓存大小
+            size_t high_pri_pool_usage_ GUARDED_BY(mutex_);
             // in-use链表的头节点，其中的节点是客户端正在使用的，其中每个LRUHandle节点的refs >= 2 , in_cache == true
             LRUHandle in_use_ GUARDED_BY(mutex_);
             // 维护一个哈希表，缓存存入的数据也存入此哈希表，用于提高缓存的查询速度
             HandleTable table_ GUARDED_BY(mutex_);
+            // 是否启用TinyLFU准入策略
+            bool admission_policy_ GUARDED_BY(mutex_);
+            // 准入策略使用的访问频率统计
+            FrequencySketch sketch_ GUARDED_BY(mutex_);
+            // 引用计数已变为0、等待删除的节点，通过next链接
+            LRUHandle* to_free_ GUARDED_BY(mutex_);
         };
 
-        LRUCache::LRUCache() : capacity_(0), usage_(0) {
+        LRUCache::LRUCache()
+            : capacity_(0), high_pri_pool_capacity_(0), usage_(0), lru_low_pri_(&lru_),
+              high_pri_pool_usage_(0), admission_policy_(false), to_free_(nullptr) {
             // 创建空的循环链表
             lru_.next = &lru_;
             lru_.prev = &lru_;
@@ -228,6 +374,7 @@ namespace leveldb {
                 Unref(e);
                 e = next;
             }
+            FreeHandles(to_free_);
         }
 
         // 缓存节点引用计数加1。
@@ -248,22 +395,45 @@ namespace leveldb {
             assert(e->refs > 0);
             // 引用数量减1
             e->refs--;
-            // 引用计数为0时则删除此节点
+            // 引用计数为0时则将此节点放入to_free_链表，此时它已不在任何链表中
             if(e->refs == 0) {
                 assert(!e->in_cache);
-                (*e->deleter)(e->key(), e->value);
-                free(e);
+                e->next = to_free_;
+                to_free_ = e;
             } else if(e->in_cache && e->refs == 1) {
                 // 引用计数为1时则将该节点从in_use_链表移动到lru_链表
                 // 也即从热数据链表移动到冷数据链表
                 LRU_Remove(e);
-                LRU_Append(&lru_, e);
+                LRU_Insert(e);
+            }
+        }
+
+        LRUHandle* LRUCache::TakeFreeList() {
+            LRUHandle* list = to_free_;
+            to_free_ = nullptr;
+            return list;
+        }
+
+        void LRUCache::FreeHandles(LRUHandle *list) {
+            while(list != nullptr) {
+                LRUHandle* next = list->next;
+                (*list->deleter)(list->key(), list->value);
+                free(list);
+                list = next;
             }
         }
 
         void LRUCache::LRU_Remove(LRUHandle *e) {
+            if(lru_low_pri_ == e) {
+                lru_low_pri_ = e->prev;
+            }
             e->next->prev = e->prev;
             e->prev->next = e->next;
+            if(e->in_high_pri_pool) {
+                assert(high_pri_pool_usage_ >= e->charge);
+                high_pri_pool_usage_ -= e->charge;
+                e->in_high_pri_pool = false;
+            }
         }
 
         void LRUCache::LRU_Append(LRUHandle *list, LRUHandle *e) {
@@ -274,6 +444,34 @@ namespace leveldb {
             e->next->prev = e;
         }
 
+        void LRUCache::LRU_Insert(LRUHandle *e) {
+            if(high_pri_pool_capacity_ > 0 && e->is_high_pri) {
+                // 插入到高优先级池的尾部，也即整个链表的尾部
+                LRU_Append(&lru_, e);
+                e->in_high_pri_pool = true;
+                high_pri_pool_usage_ += e->charge;
+                MaintainPoolSize();
+            } else {
+                // 插入到低优先级池的尾部，位于所有高优先级的节点之前
+                e->next = lru_low_pri_->next;
+                e->prev = lru_low_pri_;
+                e->prev->next = e;
+                e->next->prev = e;
+                e->in_high_pri_pool = false;
+                lru_low_pri_ = e;
+            }
+        }
+
+        void LRUCache::MaintainPoolSize() {
+            while(high_pri_pool_usage_ > high_pri_pool_capacity_) {
+                // 高优先级池中最早的节点紧跟在lru_low_pri_之后
+                lru_low_pri_ = lru_low_pri_->next;
+                assert(lru_low_pri_ != &lru_);
+                lru_low_pri_->in_high_pri_pool = false;
+                high_pri_pool_usage_ -= lru_low_pri_->charge;
+            }
+        }
+
         // 查找缓存项
         Cache::Handle* LRUCache::Lookup(const Slice &key, uint32_t hash) {
             MutexLock l(&mutex_);
@@ -282,18 +480,36 @@ namespace leveldb {
             if(e != nullptr) {
                 Ref(e);
             }
+            // 命中与未命中都计入访问频率，未命中的key之后插入时据此判断是否准入
+            if(admission_policy_) {
+                sketch_.Increment(hash);
+            }
             return reinterpret_cast<Cache::Handle*>(e);
         }
 
+        bool LRUCache::Admit(const Slice &key, uint32_t hash, size_t charge, Cache::Priority priority) {
+            if(priority == Cache::Priority::kHigh || usage_ + charge <= capacity_ || lru_.next == &lru_ ||
+               table_.Lookup(key, hash) != nullptr) {
+                return true;
+            }
+            return sketch_.Frequency(hash) > sketch_.Frequency(lru_.next->hash);
+        }
+
         void LRUCache::Release(Cache::Handle *handle) {
-            MutexLock l(&mutex_);
-            Unref(reinterpret_cast<LRUHandle*>(handle));
+            LRUHandle* to_free;
+            {
+                MutexLock l(&mutex_);
+                Unref(reinterpret_cast<LRUHandle*>(handle));
+                to_free = TakeFreeList();
+            }
+            FreeHandles(to_free);
         }
 
         // 向缓存中添加一个缓存项，刚添加的缓存项存在in_use_链表中
         Cache::Handle* LRUCache::Insert(const Slice &key, uint32_t hash, void *value, size_t charge,
-                                        void (*deleter)(const Slice &, void *)) {
-            MutexLock l(&mutex_);
+                                        void (*deleter)(const Slice &, void *), Cache::Priority priority) {
+            LRUHandle* to_free;
+            mutex_.Lock();
             // 根据参数创建一个LRUHandle
             LRUHandle* e = reinterpret_cast<LRUHandle*>(malloc(sizeof(LRUHandle) - 1 + key.size()));
             e->value = value;
@@ -302,18 +518,23 @@ namespace leveldb {
             e->key_length = key.size();
             e->hash = hash;
             e->in_cache = false;
+            e->is_high_pri = (priority == Cache::Priority::kHigh);
+            e->in_high_pri_pool = false;
             e->refs = 1;
             std::memcpy(e->key_data, key.data(), key.size());
 
-            if(capacity_ > 0) {
+            if(capacity_ > 0 && (!admission_policy_ || Admit(key, hash, charge, priority))) {
                 e->refs++;
                 e->in_cache = true;
                 LRU_Append(&in_use_, e);
                 usage_ += charge;
                 // 插入HashTable，并将其返回的旧节点删除
                 FinishErase(table_.Insert(e));
+                if(admission_policy_) {
+                    sketch_.EnsureCapacity(table_.Size());
+                }
             } else {
-                // 不需要缓存，capacity_==0表示不支持并关掉了缓存
+                // 不需要缓存，capacity_==0表示不支持并关掉了缓存，或者未通过准入策略
                 e->next = nullptr;
             }
 
@@ -327,6 +548,10 @@ namespace leveldb {
                     assert(erased);
                 }
             }
+            to_free = TakeFreeList();
+            mutex_.Unlock();
+
+            FreeHandles(to_free);
             return reinterpret_cast<Cache::Handle*>(e);
         }
 
@@ -344,20 +569,30 @@ namespace leveldb {
         }
 
         void LRUCache::Erase(const Slice &key, uint32_t hash) {
-            MutexLock l(&mutex_);
-            FinishErase(table_.Remove(key, hash));
+            LRUHandle* to_free;
+            {
+                MutexLock l(&mutex_);
+                FinishErase(table_.Remove(key, hash));
+                to_free = TakeFreeList();
+            }
+            FreeHandles(to_free);
         }
 
         void LRUCache::Prune() {
-            MutexLock l(&mutex_);
-            while(lru_.next != &lru_) {
-                LRUHandle* e = lru_.next;
-                assert(e->refs == 1);
-                bool erased = FinishErase(table_.Remove(e->key(), e->hash));
-                if(!erased) {
-                    assert(erased);
+            LRUHandle* to_free;
+            {
+                MutexLock l(&mutex_);
+                while(lru_.next != &lru_) {
+                    LRUHandle* e = lru_.next;
+                    assert(e->refs == 1);
+                    bool erased = FinishErase(table_.Remove(e->key(), e->hash));
+                    if(!erased) {
+                        assert(erased);
+                    }
                 }
+                to_free = TakeFreeList();
             }
+            FreeHandles(to_free);
         }
 
         static const int kNumShardBits = 4;
@@ -388,12 +623,16 @@ namespace leveldb {
 
         public:
             // 构造函数，为每个缓存分片设置容量
-            explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+            ShardedLRUCache(size_t capacity, double high_pri_pool_ratio, bool admission_policy) : last_id_(0) {
                 // 计算每个缓存分片的容量
                 const size_t per_shared = (capacity + (kNumShardBits - 1)) / kNumShards;
                 // 设置每个缓存分片的容量
                 for(int s = 0; s < kNumShards; s++) {
                     shard_[s].SetCapacity(per_shared);
+                    shard_[s].SetHighPriorityPoolRatio(high_pri_pool_ratio);
+                    if(admission_policy) {
+                        shard_[s].EnableAdmissionPolicy();
+                    }
                 }
             }
             ~ShardedLRUCache() override {}
@@ -401,10 +640,16 @@ namespace leveldb {
             // 将KV数据插入缓存分片
             Handle* Insert(const Slice& key, void* value, size_t charge,
                            void (*deleter)(const Slice& key, void* value)) override {
+                return Insert(key, value, charge, deleter, Priority::kLow);
+            }
+
+            Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value),
+                           Priority priority) override {
                 // 计算哈希值
                 const uint32_t hash = HashSlice(key);
                 // 插入对应的缓存分片
-                return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+                return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter, priority);
             }
 
             // 查找key
@@ -451,8 +696,13 @@ namespace leveldb {
     } // end namespace
 
     // 返回一个ShardedLRUCache
-    Cache* NewLRUCache(size_t capacity) {
-        return new ShardedLRUCache(capacity);
+    Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio, bool admission_policy) {
+        if(high_pri_pool_ratio < 0.0) {
+            high_pri_pool_ratio = 0.0;
+        } else if(high_pri_pool_ratio > 1.0) {
+            high_pri_pool_ratio = 1.0;
+        }
+        return new ShardedLRUCache(capacity, high_pri_pool_ratio, admission_policy);
     }
 
 } // end namespace leveldb
\ No newline at end of file
@@ -0,0 +1,523 @@
+#include "leveldb/cache.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+    namespace {
+
+        // CLOCK cache 的实现
+        //
+        // 每个分片是一个大小固定的开放寻址哈希表，缓存项直接保存在表的槽位中。
+        // 每个槽位的状态、引用计数以及CLOCK的访问计数都保存在一个64位的原子变量meta中：
+        //      bit 0-29  : 引用计数（包括查找过程中的临时引用）
+        //      bit 32-33 : CLOCK访问计数，命中时置为最大值，每次被扫描到时减1，为0时被淘汰
+        //      bit 62-63 : 槽位状态
+        // 槽位状态有四种：
+        // - Empty: 空槽位；
+        // - Construction: 某个线程独占该槽位，正在写入或释放缓存项；
+        // - Visible: 缓存项在缓存中，可以被Lookup()找到；
+        // - Invisible: 缓存项已经被移出缓存，但仍被客户端引用，最后一个引用释放时被删除。
+        //
+        // Lookup()与Release()不加锁：Lookup()先对槽位的meta执行fetch_add增加引用，
+        // 增加前的状态为Visible时槽位中的内容就不会被释放，再比较key；不是要找的key时释放这个引用。
+        // 槽位只有在Invisible且引用为0时才能被释放，通过CAS将其切换为Construction来保证只有一个线程释放它。
+        // Insert()、Erase()和淘汰需要修改槽位的内容，由分片的互斥锁串行化，
+        // 因此持有锁时Visible的槽位中的内容是稳定的。
+        //
+        // 持有互斥锁时被删除的缓存项先记录在PendingDelete中，释放锁之后才调用其deleter，
+        // 因此deleter中可以访问其他Cache，不会与分片的锁互相嵌套。
+        //
+        // 开放寻址使用双重哈希。每个槽位记录有多少个缓存项在插入时经过了该槽位（displacements），
+        // 查找时遇到displacements为0的槽位即可停止，缓存项被释放时再将其经过的槽位减1。
+
+        // 槽位的数量按照每个缓存项约占用kEstimatedEntryCharge估计，
+        // 缓存项较小时由kMaxLoadFactor限制槽位的使用率，此时会在容量用满之前淘汰缓存项
+        static const size_t kEstimatedEntryCharge = 4 * 1024;
+        static const double kLoadFactor = 0.7;
+        static const double kMaxLoadFactor = 0.84;
+
+        static const uint64_t kRefsMask = (uint64_t{1} << 30) - 1;
+        static const int kCountdownShift = 32;
+        static const uint64_t kCountdownMask = uint64_t{3} << kCountdownShift;
+        static const int kStateShift = 62;
+        // 新插入的低优先级、高优先级缓存项与命中的缓存项的访问计数，
+        // 高优先级的缓存项需要多经过几轮扫描才会被淘汰
+        static const uint64_t kLowPriInitialCountdown = 1;
+        static const uint64_t kHighPriInitialCountdown = 2;
+        static const uint64_t kMaxCountdown = 3;
+
+        enum SlotState : uint64_t {
+            kStateEmpty = 0,
+            kStateConstruction = 1,
+            kStateVisible = 2,
+            kStateInvisible = 3
+        };
+
+        static inline uint64_t StateOf(uint64_t meta) { return meta >> kStateShift; }
+        static inline uint64_t RefsOf(uint64_t meta) { return meta & kRefsMask; }
+        static inline uint64_t CountdownOf(uint64_t meta) {
+            return (meta & kCountdownMask) >> kCountdownShift;
+        }
+
+        struct ClockHandle {
+            std::atomic<uint64_t> meta;
+            // 插入时经过该槽位的缓存项数量
+            std::atomic<uint32_t> displacements;
+            // 查找时不持有引用就会读取，用于快速跳过不匹配的槽位
+            std::atomic<uint32_t> hash;
+            // 不在表中的缓存项（缓存已满或容量为0），由Release()直接释放
+            bool detached;
+            char* key_data;
+            size_t key_length;
+            void* value;
+            void (*deleter)(const Slice&, void* value);
+            size_t charge;
+
+            Slice key() const { return Slice(key_data, key_length); }
+        };
+
+        // 已从槽位中移除、等待调用deleter的缓存项
+        struct PendingDelete {
+            char* key_data;
+            size_t key_length;
+            void* value;
+            void (*deleter)(const Slice&, void* value);
+        };
+
+        // ClockCache是ShardedClockCache的一个分片
+        class ClockCache {
+        public:
+            ClockCache();
+            ~ClockCache();
+
+            void SetCapacity(size_t capacity);
+
+            Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                                  size_t charge,
+                                  void (*deleter)(const Slice& key, void* value),
+                                  Cache::Priority priority);
+
+            Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+
+            void Release(Cache::Handle* handle);
+            void Erase(const Slice& key, uint32_t hash);
+            void Prune();
+            size_t TotalCharge() const {
+                return usage_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            // 双重哈希的探测序列：第i次探测的槽位为 (base + i * increment) & mask_
+            uint32_t ProbeBase(uint32_t hash) const { return hash & mask_; }
+            static uint32_t ProbeIncrement(uint32_t hash) {
+                // 奇数的步长保证可以遍历所有2的幂个槽位
+                return ((hash * 0x9e3779b9u) >> 16) | 1;
+            }
+
+            // 持有mutex_时查找Visible的缓存项
+            ClockHandle* FindVisible(const Slice& key, uint32_t hash) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 将Visible的缓存项移出缓存，被删除的缓存项加入*deferred
+            void MakeInvisible(ClockHandle* h, std::vector<PendingDelete>* deferred) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 淘汰缓存项，直到加入charge后不超过容量且槽位使用率不超过上限，或者没有可以淘汰的缓存项
+            void EvictFromClock(size_t charge, std::vector<PendingDelete>* deferred) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+            // 释放一个引用，若这是Invisible的缓存项的最后一个引用则删除它
+            void Unref(ClockHandle* h);
+            // 尝试独占一个Invisible且引用为0的槽位以删除其中的缓存项
+            static bool TryClaimForFree(ClockHandle* h);
+            // 删除已被独占的槽位中的缓存项。deferred不为nullptr时不调用deleter，而是将缓存项加入*deferred
+            void FreeClaimed(ClockHandle* h, std::vector<PendingDelete>* deferred);
+            // 在释放mutex_之后调用，删除deferred中的缓存项
+            static void RunDeleters(const std::vector<PendingDelete>& deferred);
+
+            size_t capacity_;
+            std::atomic<size_t> usage_;
+            // 非空槽位的数量
+            std::atomic<uint32_t> occupancy_;
+            uint32_t max_occupancy_;
+            uint32_t mask_;
+            ClockHandle* slots_;
+            // CLOCK指针，下一个被扫描的槽位
+            uint32_t clock_pointer_ GUARDED_BY(mutex_);
+            mutable port::Mutex mutex_;
+        };
+
+        ClockCache::ClockCache()
+            : capacity_(0), usage_(0), occupancy_(0), max_occupancy_(0), mask_(0),
+              slots_(nullptr), clock_pointer_(0) {}
+
+        ClockCache::~ClockCache() {
+            for(uint32_t i = 0; slots_ != nullptr && i <= mask_; i++) {
+                ClockHandle* h = &slots_[i];
+                const uint64_t meta = h->meta.load(std::memory_order_relaxed);
+                if(StateOf(meta) == kStateVisible) {
+                    assert(RefsOf(meta) == 0);
+                    (*h->deleter)(h->key(), h->value);
+                    free(h->key_data);
+                }
+            }
+            delete[] slots_;
+        }
+
+        void ClockCache::SetCapacity(size_t capacity) {
+            assert(slots_ == nullptr);
+            capacity_ = capacity;
+            const double estimated_entries = static_cast<double>(capacity) / kEstimatedEntryCharge / kLoadFactor;
+            uint32_t num_slots = 16;
+            while(num_slots < estimated_entries && num_slots < (uint32_t{1} << 30)) {
+                num_slots *= 2;
+            }
+            slots_ = new ClockHandle[num_slots];
+            for(uint32_t i = 0; i < num_slots; i++) {
+                slots_[i].meta.store(0, std::memory_order_relaxed);
+                slots_[i].displacements.store(0, std::memory_order_relaxed);
+                slots_[i].hash.store(0, std::memory_order_relaxed);
+                slots_[i].detached = false;
+            }
+            mask_ = num_slots - 1;
+            max_occupancy_ = static_cast<uint32_t>(num_slots * kMaxLoadFactor);
+        }
+
+        Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash) {
+            const uint32_t base = ProbeBase(hash);
+            const uint32_t increment = ProbeIncrement(hash);
+            for(uint32_t i = 0; i <= mask_; i++) {
+                ClockHandle* h = &slots_[(base + i * increment) & mask_];
+                if(h->hash.load(std::memory_order_relaxed) == hash &&
+                   StateOf(h->meta.load(std::memory_order_relaxed)) == kStateVisible) {
+                    // 先增加引用，此后槽位中的内容不会被释放
+                    const uint64_t old = h->meta.fetch_add(1, std::memory_order_acquire);
+                    if(StateOf(old) == kStateVisible && h->hash.load(std::memory_order_relaxed) == hash &&
+                       h->key() == key) {
+                        if(CountdownOf(old) < kMaxCountdown) {
+                            h->meta.fetch_or(kMaxCountdown << kCountdownShift, std::memory_order_relaxed);
+                        }
+                        return reinterpret_cast<Cache::Handle*>(h);
+                    }
+                    Unref(h);
+                }
+                if(h->displacements.load(std::memory_order_relaxed) == 0) {
+                    // 没有缓存项在插入时经过该槽位，key不会在之后的槽位中
+                    break;
+                }
+            }
+            return nullptr;
+        }
+
+        void ClockCache::Release(Cache::Handle* handle) {
+            Unref(reinterpret_cast<ClockHandle*>(handle));
+        }
+
+        void ClockCache::Unref(ClockHandle* h) {
+            const uint64_t old = h->meta.fetch_sub(1, std::memory_order_acq_rel);
+            assert(RefsOf(old) > 0);
+            if(StateOf(old) == kStateInvisible && RefsOf(old) == 1 && TryClaimForFree(h)) {
+                FreeClaimed(h, nullptr);
+            }
+        }
+
+        bool ClockCache::TryClaimForFree(ClockHandle* h) {
+            uint64_t meta = h->meta.load(std::memory_order_acquire);
+            while(StateOf(meta) == kStateInvisible && RefsOf(meta) == 0) {
+                if(h->meta.compare_exchange_weak(meta, uint64_t{kStateConstruction} << kStateShift,
+                                                 std::memory_order_acq_rel)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void ClockCache::FreeClaimed(ClockHandle* h, std::vector<PendingDelete>* deferred) {
+            if(deferred != nullptr) {
+                deferred->push_back(PendingDelete{h->key_data, h->key_length, h->value, h->deleter});
+            } else {
+                (*h->deleter)(h->key(), h->value);
+                free(h->key_data);
+            }
+            if(h->detached) {
+                delete h;
+                return;
+            }
+            usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+            // 撤销该缓存项插入时在经过的槽位上留下的记录
+            const uint32_t hash = h->hash.load(std::memory_order_relaxed);
+            const uint32_t base = ProbeBase(hash);
+            const uint32_t increment = ProbeIncrement(hash);
+            for(uint32_t i = 0; i <= mask_; i++) {
+                ClockHandle* p = &slots_[(base + i * increment) & mask_];
+                if(p == h) {
+                    break;
+                }
+                p->displacements.fetch_sub(1, std::memory_order_relaxed);
+            }
+            occupancy_.fetch_sub(1, std::memory_order_relaxed);
+            // 其他线程在查找时留下的临时引用由它们自己撤销，因此这里只清除状态位
+            h->meta.fetch_and(kRefsMask, std::memory_order_release);
+        }
+
+        void ClockCache::RunDeleters(const std::vector<PendingDelete>& deferred) {
+            for(const PendingDelete& d : deferred) {
+                (*d.deleter)(Slice(d.key_data, d.key_length), d.value);
+                free(d.key_data);
+            }
+        }
+
+        ClockHandle* ClockCache::FindVisible(const Slice& key, uint32_t hash) {
+            const uint32_t base = ProbeBase(hash);
+            const uint32_t increment = ProbeIncrement(hash);
+            for(uint32_t i = 0; i <= mask_; i++) {
+                ClockHandle* h = &slots_[(base + i * increment) & mask_];
+                if(StateOf(h->meta.load(std::memory_order_acquire)) == kStateVisible &&
+                   h->hash.load(std::memory_order_relaxed) == hash && h->key() == key) {
+                    return h;
+                }
+                if(h->displacements.load(std::memory_order_relaxed) == 0) {
+                    break;
+                }
+            }
+            return nullptr;
+        }
+
+        void ClockCache::MakeInvisible(ClockHandle* h, std::vector<PendingDelete>* deferred) {
+            uint64_t meta = h->meta.load(std::memory_order_relaxed);
+            while(!h->meta.compare_exchange_weak(
+                    meta, (meta & ~(uint64_t{3} << kStateShift)) | (uint64_t{kStateInvisible} << kStateShift),
+                    std::memory_order_acq_rel)) {
+            }
+            assert(StateOf(meta) == kStateVisible);
+            if(RefsOf(meta) == 0 && TryClaimForFree(h)) {
+                FreeClaimed(h, deferred);
+            }
+        }
+
+        void ClockCache::EvictFromClock(size_t charge, std::vector<PendingDelete>* deferred) {
+            // 最多扫描两轮：第一轮将访问计数减到0，第二轮淘汰
+            const uint64_t max_steps = (uint64_t{mask_} + 1) * (kMaxCountdown + 1);
+            for(uint64_t step = 0; step < max_steps; step++) {
+                if(usage_.load(std::memory_order_relaxed) + charge <= capacity_ &&
+                   occupancy_.load(std::memory_order_relaxed) < max_occupancy_) {
+                    return;
+                }
+                ClockHandle* h = &slots_[clock_pointer_++ & mask_];
+                uint64_t meta = h->meta.load(std::memory_order_relaxed);
+                if(StateOf(meta) != kStateVisible || RefsOf(meta) != 0) {
+                    continue;
+                }
+                if(CountdownOf(meta) > 0) {
+                    // 最近被访问过，再给一次机会
+                    h->meta.compare_exchange_strong(meta, meta - (uint64_t{1} << kCountdownShift),
+                                                    std::memory_order_relaxed);
+                } else if(h->meta.compare_exchange_strong(meta, uint64_t{kStateConstruction} << kStateShift,
+                                                          std::memory_order_acq_rel)) {
+                    // 没有引用时直接独占并删除，失败说明刚好有线程在查找它，跳过即可
+                    FreeClaimed(h, deferred);
+                }
+            }
+        }
+
+        Cache::Handle* ClockCache::Insert(const Slice& key, uint32_t hash, void* value, size_t charge,
+                                          void (*deleter)(const Slice&, void*), Cache::Priority priority) {
+            char* key_data = reinterpret_cast<char*>(malloc(key.size() > 0 ? key.size() : 1));
+            std::memcpy(key_data, key.data(), key.size());
+
+            if(capacity_ > 0) {
+                ClockHandle* h = nullptr;
+                std::vector<PendingDelete> deferred;
+                {
+                    MutexLock l(&mutex_);
+                    // 相同key的旧缓存项被移出缓存
+                    ClockHandle* old = FindVisible(key, hash);
+                    if(old != nullptr) {
+                        MakeInvisible(old, &deferred);
+                    }
+                    EvictFromClock(charge, &deferred);
+
+                    // 沿探测序列寻找空槽位，并在经过的槽位上留下记录
+                    const uint32_t base = ProbeBase(hash);
+                    const uint32_t increment = ProbeIncrement(hash);
+                    uint32_t i = 0;
+                    if(occupancy_.load(std::memory_order_relaxed) < max_occupancy_) {
+                        for(; i <= mask_; i++) {
+                            ClockHandle* p = &slots_[(base + i * increment) & mask_];
+                            uint64_t expected = 0;
+                            if(p->meta.compare_exchange_strong(expected, uint64_t{kStateConstruction} << kStateShift,
+                                                               std::memory_order_acq_rel)) {
+                                h = p;
+                                break;
+                            }
+                            p->displacements.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                    if(h != nullptr) {
+                        occupancy_.fetch_add(1, std::memory_order_relaxed);
+                        usage_.fetch_add(charge, std::memory_order_relaxed);
+                        h->hash.store(hash, std::memory_order_relaxed);
+                        h->key_data = key_data;
+                        h->key_length = key.size();
+                        h->value = value;
+                        h->deleter = deleter;
+                        h->charge = charge;
+                        // 调用者持有一个引用；保留查找者的临时引用，只修改状态位与访问计数
+                        const uint64_t countdown = (priority == Cache::Priority::kHigh ? kHighPriInitialCountdown
+                                                                                       : kLowPriInitialCountdown);
+                        h->meta.fetch_add((uint64_t{kStateVisible - kStateConstruction} << kStateShift) |
+                                          (countdown << kCountdownShift) | 1,
+                                          std::memory_order_release);
+                    } else {
+                        // 没有空槽位，撤销留下的记录
+                        for(uint32_t j = 0; j < i; j++) {
+                            slots_[(base + j * increment) & mask_].displacements.fetch_sub(1, std::memory_order_relaxed);
+                        }
+                    }
+                }
+                RunDeleters(deferred);
+                if(h != nullptr) {
+                    return reinterpret_cast<Cache::Handle*>(h);
+                }
+            }
+
+            // 不需要缓存，或者所有槽位都在被使用，返回一个不在缓存中的缓存项
+            ClockHandle* h = new ClockHandle;
+            h->meta.store((uint64_t{kStateInvisible} << kStateShift) | 1, std::memory_order_relaxed);
+            h->displacements.store(0, std::memory_order_relaxed);
+            h->hash.store(hash, std::memory_order_relaxed);
+            h->detached = true;
+            h->key_data = key_data;
+            h->key_length = key.size();
+            h->value = value;
+            h->deleter = deleter;
+            h->charge = charge;
+            return reinterpret_cast<Cache::Handle*>(h);
+        }
+
+        void ClockCache::Erase(const Slice& key, uint32_t hash) {
+            std::vector<PendingDelete> deferred;
+            {
+                MutexLock l(&mutex_);
+                ClockHandle* h = FindVisible(key, hash);
+                if(h != nullptr) {
+                    MakeInvisible(h, &deferred);
+                }
+            }
+            RunDeleters(deferred);
+        }
+
+        void ClockCache::Prune() {
+            std::vector<PendingDelete> deferred;
+            {
+                MutexLock l(&mutex_);
+                for(uint32_t i = 0; i <= mask_; i++) {
+                    ClockHandle* h = &slots_[i];
+                    uint64_t meta = h->meta.load(std::memory_order_relaxed);
+                    if(StateOf(meta) == kStateVisible && RefsOf(meta) == 0 &&
+                       h->meta.compare_exchange_strong(meta, uint64_t{kStateConstruction} << kStateShift,
+                                                       std::memory_order_acq_rel)) {
+                        FreeClaimed(h, &deferred);
+                    }
+                }
+            }
+            RunDeleters(deferred);
+        }
+
+        // ShardedClockCache由1 << num_shard_bits个ClockCache分片组成，
+        // 分片只用于减少Insert()等操作对互斥锁的竞争，Lookup()与Release()本身不加锁
+        class ShardedClockCache : public Cache {
+        private:
+            ClockCache* shards_;
+            const int num_shard_bits_;
+            std::atomic<uint64_t> last_id_;
+
+            static inline uint32_t HashSlice(const Slice& s) {
+                return Hash(s.data(), s.size(), 0);
+            }
+
+            // 使用hash的高位选择分片，低位用于分片内的探测
+            uint32_t Shard(uint32_t hash) const {
+                return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
+            }
+
+        public:
+            ShardedClockCache(size_t capacity, int num_shard_bits)
+                : num_shard_bits_(num_shard_bits), last_id_(0) {
+                const int num_shards = 1 << num_shard_bits_;
+                shards_ = new ClockCache[num_shards];
+                const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+                for(int s = 0; s < num_shards; s++) {
+                    shards_[s].SetCapacity(per_shard);
+                }
+            }
+            ~ShardedClockCache() override { delete[] shards_; }
+
+            using Cache::Insert;
+            Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value)) override {
+                return Insert(key, value, charge, deleter, Priority::kLow);
+            }
+
+            Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value),
+                           Priority priority) override {
+                const uint32_t hash = HashSlice(key);
+                return shards_[Shard(hash)].Insert(key, hash, value, charge, deleter, priority);
+            }
+
+            Handle* Lookup(const Slice& key) override {
+                const uint32_t hash = HashSlice(key);
+                return shards_[Shard(hash)].Lookup(key, hash);
+            }
+
+            void Release(Handle* handle) override {
+                ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+                shards_[Shard(h->hash.load(std::memory_order_relaxed))].Release(handle);
+            }
+
+            void Erase(const Slice& key) override {
+                const uint32_t hash = HashSlice(key);
+                shards_[Shard(hash)].Erase(key, hash);
+            }
+
+            void* Value(Handle* handle) override {
+                return reinterpret_cast<ClockHandle*>(handle)->value;
+            }
+
+            uint64_t NewId() override {
+                return last_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+
+            void Prune() override {
+                for(int s = 0; s < (1 << num_shard_bits_); s++) {
+                    shards_[s].Prune();
+                }
+            }
+
+            size_t TotalCharge() const override {
+                size_t total = 0;
+                for(int s = 0; s < (1 << num_shard_bits_); s++) {
+                    total += shards_[s].TotalCharge();
+                }
+                return total;
+            }
+        };
+
+    } // end namespace
+
+    Cache* NewClockCache(size_t capacity, int num_shard_bits) {
+        if(num_shard_bits < 0) {
+            num_shard_bits = 0;
+        } else if(num_shard_bits > 16) {
+            num_shard_bits = 16;
+        }
+        return new ShardedClockCache(capacity, num_shard_bits);
+    }
+
+} // end namespace leveldb
@@ -0,0 +1,100 @@
+#include "util/dynamic_bloom.h"
+
+#include <cassert>
+#include <new>
+
+#include "util/arena.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+    namespace {
+        // 一个cache line的字节数、字数与bit数
+        static const size_t kLineBytes = 64;
+        static const uint32_t kWordsPerLine = kLineBytes / sizeof(uint64_t);
+        static const uint32_t kLineBits = kLineBytes * 8;
+        // 每个key设置的bit数
+        static const int kNumProbes = 6;
+        // 生成探测序列的乘数
+        static const uint32_t kProbeMultiplier = 0x9e3779b9;
+
+        static inline uint32_t BloomHash(const Slice& key) {
+            return Hash(key.data(), key.size(), 0xbc9f1d34);
+        }
+
+        // 打散h得到探测序列的种子，使其与选择cache line所用的高位不相关
+        static inline uint32_t ProbeSeed(uint32_t h) {
+            h ^= h >> 16;
+            h *= 0x85ebca6b;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35;
+            h ^= h >> 16;
+            return h;
+        }
+    } // end anonymous namespace
+
+    DynamicBloom::DynamicBloom(Arena* arena, uint32_t total_bits) {
+        assert(total_bits > 0);
+        num_lines_ = (total_bits + kLineBits - 1) / kLineBits;
+        // 多分配一个cache line，以便将起始地址对齐到cache line
+        char* raw = arena->AllocateAligned(static_cast<size_t>(num_lines_) * kLineBytes + kLineBytes);
+        uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+        addr = (addr + kLineBytes - 1) & ~static_cast<uintptr_t>(kLineBytes - 1);
+        data_ = reinterpret_cast<std::atomic<uint64_t>*>(addr);
+        for(uint32_t i = 0; i < num_lines_ * kWordsPerLine; i++) {
+            new (&data_[i]) std::atomic<uint64_t>(0);
+        }
+    }
+
+    std::atomic<uint64_t>* DynamicBloom::Line(uint32_t h) const {
+        // 将h映射到[0, num_lines_)，比取模更快
+        const uint32_t line = static_cast<uint32_t>((static_cast<uint64_t>(h) * num_lines_) >> 32);
+        return data_ + static_cast<size_t>(line) * kWordsPerLine;
+    }
+
+    void DynamicBloom::Add(const Slice& key) {
+        const uint32_t h = BloomHash(key);
+        std::atomic<uint64_t>* line = Line(h);
+        uint32_t h2 = ProbeSeed(h);
+        for(int i = 0; i < kNumProbes; i++) {
+            h2 *= kProbeMultiplier;
+            // 高9位即为cache line内的bit偏移
+            const uint32_t bitpos = h2 >> 23;
+            std::atomic<uint64_t>& word = line[bitpos >> 6];
+            // 只有一个写者，读-改-写不需要原子操作，只需保证读者不会读到撕裂的值
+            word.store(word.load(std::memory_order_relaxed) | (uint64_t{1} << (bitpos & 63)),
+                       std::memory_order_relaxed);
+        }
+    }
+
+    void DynamicBloom::AddConcurrently(const Slice& key) {
+        const uint32_t h = BloomHash(key);
+        std::atomic<uint64_t>* line = Line(h);
+        uint32_t h2 = ProbeSeed(h);
+        for(int i = 0; i < kNumProbes; i++) {
+            h2 *= kProbeMultiplier;
+            const uint32_t bitpos = h2 >> 23;
+            const uint64_t mask = uint64_t{1} << (bitpos & 63);
+            std::atomic<uint64_t>& word = line[bitpos >> 6];
+            // bit已经被设置时跳过写操作，避免多个写者争抢同一个cache line
+            if((word.load(std::memory_order_relaxed) & mask) == 0) {
+                word.fetch_or(mask, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool DynamicBloom::MayContain(const Slice& key) const {
+        const uint32_t h = BloomHash(key);
+        const std::atomic<uint64_t>* line = Line(h);
+        uint32_t h2 = ProbeSeed(h);
+        for(int i = 0; i < kNumProbes; i++) {
+            h2 *= kProbeMultiplier;
+            const uint32_t bitpos = h2 >> 23;
+            if((line[bitpos >> 6].load(std::memory_order_relaxed) & (uint64_t{1} << (bitpos & 63))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // end namespace leveldb
@@ -0,0 +1,44 @@
+#ifndef LLEVELDB_DYNAMIC_BLOOM_H
+#define LLEVELDB_DYNAMIC_BLOOM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+    class Arena;
+
+    // 可以边插入边查询的Bloom filter，用于memtable。与FilterPolicy生成的filter不同，
+    // 它不需要事先知道所有的key，空间在构造时一次性从Arena中分配。
+    // 一个key的所有bit位于同一个64字节的cache line中，因此插入和查询都只访问一个cache line。
+    // 每个bit所在的字都是原子变量：Add()与MayContain()可以同时调用，
+    // 多个线程也可以同时调用AddConcurrently()。
+    class DynamicBloom {
+    public:
+        // total_bits会向上取整为512的倍数，要求total_bits > 0
+        DynamicBloom(Arena* arena, uint32_t total_bits);
+
+        DynamicBloom(const DynamicBloom&) = delete;
+        DynamicBloom& operator=(const DynamicBloom&) = delete;
+
+        // 加入key，调用者需保证不会与AddConcurrently()同时调用
+        void Add(const Slice& key);
+        // Add()的线程安全版本
+        void AddConcurrently(const Slice& key);
+        // key可能被加入过时返回true，返回false时key一定没有被加入过
+        bool MayContain(const Slice& key) const;
+
+    private:
+        // 返回key所在的cache line的第一个字
+        std::atomic<uint64_t>* Line(uint32_t h) const;
+
+        uint32_t num_lines_;
+        std::atomic<uint64_t>* data_;
+    };
+
+} // end namespace leveldb
+
+#endif //LLEVELDB_DYNAMIC_BLOOM_H
@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -665,7 +666,14 @@ namespace leveldb {
             }
 
             void Schedule(void (*background_work_function)(void* background_work_arg),
-                          void* background_work_arg) override;
+                          void* background_work_arg) override {
+                Schedule(background_work_function, background_work_arg, LOW);
+            }
+
+            void Schedule(void (*background_work_function)(void* background_work_arg),
+                          void* background_work_arg, Priority pri) override;
+
+            void SetBackgroundThreads(int number, Priority pri) override;
 
             void StartThread(void (*thread_main)(void* thread_main_arg),
                              void* thread_main_arg) override {
@@ -720,12 +728,17 @@ namespace leveldb {
 
         private:
 
-            void BackgroundThreadMain();
+            struct BackgroundThreadPool;
 
-            static void BackgroundThreadEntryPoint(PosixEnv* env) {
-                env->BackgroundThreadMain();
+            void BackgroundThreadMain(BackgroundThreadPool* pool);
+
+            static void BackgroundThreadEntryPoint(PosixEnv* env, BackgroundThreadPool* pool) {
+                env->BackgroundThreadMain(pool);
             }
 
+            // 启动后台线程，直到线程池中的线程数量达到设定值
+            void StartBackgroundThreads(BackgroundThreadPool* pool);
+
             // 将work item data存在一个Schedule()调用中
             //
             // 工作任务实例在线程调用Schedule()时构造，并在后台线程中使用
@@ -737,12 +750,22 @@ namespace leveldb {
                 void* const arg;
             };
 
-            port::Mutex background_work_mutex_;
-            port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-            bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+            // 一个优先级对应的后台线程池，各线程从同一个工作队列中取任务执行
+            struct BackgroundThreadPool {
+                BackgroundThreadPool() : cv(&mu), total_threads(1), started_threads(0) {}
+
+                port::Mutex mu;
+                port::CondVar cv GUARDED_BY(mu);
+                // 线程池应有的线程数量
+                int total_threads GUARDED_BY(mu);
+                // 已经启动且还未退出的线程数量，线程在第一次调度任务时才启动
+                int started_threads GUARDED_BY(mu);
+                // 工作队列，队列中放的都是需要被线程执行的任务
+                std::queue<BackgroundWorkItem> work_queue GUARDED_BY(mu);
+            };
 
-            // 工作队列，队列中放的都是需要被线程执行的任务
-            std::queue<BackgroundWorkItem> background_work_queue_ GUARDED_BY(background_work_mutex_);
+            // 按Priority索引的后台线程池
+            BackgroundThreadPool background_pools_[2];
 
             PosixLockTable locks_;
             Limiter mmap_limiter_;
@@ -780,47 +803,65 @@ namespace leveldb {
     } // end namespace
 
     PosixEnv::PosixEnv()
-        : background_work_cv_(&background_work_mutex_),
-          started_background_thread_(false),
-          mmap_limiter_(MaxMmaps()),
+        : mmap_limiter_(MaxMmaps()),
           fd_limiter_(MaxOpenFiles()) {}
 
-    // 线程调度函数，启动后台主线程，向工作队列中插入任务，负责任务的调度
-    void PosixEnv::Schedule(void (*background_work_function)(void *), void *background_work_arg) {
-        background_work_mutex_.Lock();
-        // 如果没有启动后台线程的话，则启动后台主线程
-        if(!started_background_thread_) {
-            started_background_thread_ = true;
-            std::thread background_thread(PosixEnv::BackgroundThreadEntryPoint, this);
+    // 线程调度函数，按需启动对应线程池的后台线程，向工作队列中插入任务，负责任务的调度
+    void PosixEnv::Schedule(void (*background_work_function)(void *), void *background_work_arg,
+                            Priority pri) {
+        BackgroundThreadPool* pool = &background_pools_[pri];
+        pool->mu.Lock();
+        StartBackgroundThreads(pool);
+        // 向工作队列中插入一个任务，并唤醒一个等待中的后台线程
+        pool->work_queue.emplace(background_work_function, background_work_arg);
+        pool->cv.Signal();
+        pool->mu.Unlock();
+    }
+
+    void PosixEnv::SetBackgroundThreads(int number, Priority pri) {
+        BackgroundThreadPool* pool = &background_pools_[pri];
+        pool->mu.Lock();
+        pool->total_threads = std::max(number, 1);
+        if(pool->started_threads > 0) {
+            // 线程池已经在使用中，增加的线程立即启动，多余的线程被唤醒后自行退出
+            StartBackgroundThreads(pool);
+            pool->cv.SignalAll();
+        }
+        pool->mu.Unlock();
+    }
+
+    void PosixEnv::StartBackgroundThreads(BackgroundThreadPool* pool) {
+        pool->mu.AssertHeld();
+        while(pool->started_threads < pool->total_threads) {
+            pool->started_threads++;
+            std::thread background_thread(PosixEnv::BackgroundThreadEntryPoint, this, pool);
             // detach模式，由内核回收线程资源，线程单独执行，执行完毕释放资源
             background_thread.detach();
         }
-        // 如果队列为空，则后台线程可能会等待
-        if(background_work_queue_.empty()) {
-            background_work_cv_.Signal();
-        }
-
-        // 向工作队列中插入一个任务
-        background_work_queue_.emplace(background_work_function, background_work_arg);
-        background_work_mutex_.Unlock();
     }
 
-    // 后台主线程，从工作队列中取出任务并执行任务，负责任务的执行
-    void PosixEnv::BackgroundThreadMain() {
+    // 后台线程，从所属线程池的工作队列中取出任务并执行任务，负责任务的执行
+    void PosixEnv::BackgroundThreadMain(BackgroundThreadPool* pool) {
         while(true) {
-            background_work_mutex_.Lock();
-            // 等待，直到有work完成
-            while(background_work_queue_.empty()) {
-                background_work_cv_.Wait();
+            pool->mu.Lock();
+            // 等待，直到有新的任务或线程池被缩小
+            while(pool->work_queue.empty() && pool->started_threads <= pool->total_threads) {
+                pool->cv.Wait();
+            }
+            // 线程池被缩小，多余的线程退出
+            if(pool->started_threads > pool->total_threads) {
+                pool->started_threads--;
+                pool->mu.Unlock();
+                return;
             }
 
-            assert(!background_work_queue_.empty());
+            assert(!pool->work_queue.empty());
             // 获取work函数，也即取出工作任务
-            auto background_work_function = background_work_queue_.front().function;
+            auto background_work_function = pool->work_queue.front().function;
             // 获取work参数，也即取出执行工作任务所需要的一些参数
-            void* background_work_arg = background_work_queue_.front().arg;
-            background_work_queue_.pop();
-            background_work_mutex_.Unlock();
+            void* background_work_arg = pool->work_queue.front().arg;
+            pool->work_queue.pop();
+            pool->mu.Unlock();
             // 执行任务
             background_work_function(background_work_arg);
         }
@@ -1,7 +1,15 @@
 #include "leveldb/filter_policy.h"
 
+#include "leveldb/slice.h"
+
 namespace leveldb {
 
     FilterPolicy::~FilterPolicy() {}
+
+    void FilterPolicy::KeysMayMatch(int n, const Slice* keys, const Slice& filter, bool* may_match) const {
+        for(int i = 0; i < n; i++) {
+            may_match[i] = KeyMayMatch(keys[i], filter);
+        }
+    }
     
 } // end namespace leveldb
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "leveldb/persistent_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/logging.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+    PersistentCache::~PersistentCache() {}
+
+    namespace {
+
+        // 段文件中的每条记录的格式为：
+        //      crc: fixed32       <----- key_size、data_size、key、data的crc32c（masked）
+        //      key_size: fixed32
+        //      data_size: fixed32
+        //      key: char[key_size]
+        //      data: char[data_size]
+        static const size_t kRecordHeaderSize = 12;
+        static const char kSegmentSuffix[] = ".pcache";
+        // 段的大小为容量的1/kSegmentsPerCapacity，淘汰以段为单位进行
+        static const uint64_t kSegmentsPerCapacity = 16;
+        static const uint64_t kMinSegmentSize = 64 * 1024;
+        static const uint64_t kMaxSegmentSize = 64 * 1024 * 1024;
+        // 还未写入磁盘的段达到该数量时，不再插入新的数据，避免写入跟不上时内存中积压过多的段
+        static const size_t kMaxPendingSegments = 2;
+
+        // 将key和data编码为一条记录追加到dst
+        static void EncodeRecord(const Slice& key, const Slice& data, std::string* dst) {
+            const size_t start = dst->size();
+            PutFixed32(dst, 0);
+            PutFixed32(dst, static_cast<uint32_t>(key.size()));
+            PutFixed32(dst, static_cast<uint32_t>(data.size()));
+            dst->append(key.data(), key.size());
+            dst->append(data.data(), data.size());
+            const uint32_t crc = crc32c::Value(dst->data() + start + 4, dst->size() - start - 4);
+            EncodeFixed32(&(*dst)[start], crc32c::Mask(crc));
+        }
+
+        // 从input的开头解析一条记录，成功时返回true，并将记录的长度存入*record_size
+        static bool DecodeRecord(const Slice& input, Slice* key, Slice* data, size_t* record_size) {
+            if(input.size() < kRecordHeaderSize) {
+                return false;
+            }
+            const char* p = input.data();
+            const uint32_t key_size = DecodeFixed32(p + 4);
+            const uint32_t data_size = DecodeFixed32(p + 8);
+            const uint64_t size = kRecordHeaderSize + static_cast<uint64_t>(key_size) + data_size;
+            if(size > input.size()) {
+                return false;
+            }
+            const uint32_t crc = crc32c::Unmask(DecodeFixed32(p));
+            if(crc32c::Value(p + 4, size - 4) != crc) {
+                return false;
+            }
+            *key = Slice(p + kRecordHeaderSize, key_size);
+            *data = Slice(p + kRecordHeaderSize + key_size, data_size);
+            *record_size = static_cast<size_t>(size);
+            return true;
+        }
+
+        class SegmentedPersistentCache : public PersistentCache {
+        public:
+            SegmentedPersistentCache(Env* env, const std::string& path, uint64_t capacity)
+                : env_(env),
+                  path_(path),
+                  capacity_(capacity),
+                  segment_size_(std::min(std::max(capacity / kSegmentsPerCapacity, kMinSegmentSize),
+                                         kMaxSegmentSize)),
+                  bg_cv_(&mutex_),
+                  active_number_(1),
+                  total_size_(0),
+                  bg_scheduled_(false) {}
+
+            ~SegmentedPersistentCache() override {
+                MutexLock l(&mutex_);
+                // 等待后台的写入完成
+                while(bg_scheduled_) {
+                    bg_cv_.Wait();
+                }
+                // 正在写入的段只在内存中，关闭时写入磁盘，下次打开时可以继续使用
+                if(!active_buffer_.empty()) {
+                    SealActiveSegment();
+                }
+                WritePendingSegments();
+            }
+
+            // 扫描path_下已有的段文件，重建索引
+            Status Recover();
+
+            Status Insert(const Slice& key, const Slice& data) override;
+            Status Lookup(const Slice& key, std::string* data) override;
+
+            uint64_t TotalSize() const override {
+                MutexLock l(&mutex_);
+                return total_size_;
+            }
+
+        private:
+            // 已经写入磁盘的段
+            struct Segment {
+                uint64_t size;
+                // 读取时在锁外使用，淘汰时即使文件被删除，正在进行的读取仍然可以完成
+                std::shared_ptr<RandomAccessFile> file;
+                // 段中所有记录的key，淘汰该段时用于清理索引
+                std::vector<std::string> keys;
+            };
+
+            // 已经写满、等待写入磁盘的段
+            struct PendingSegment {
+                uint64_t number;
+                std::shared_ptr<std::string> buffer;
+                std::vector<std::string> keys;
+            };
+
+            // 一条记录的位置
+            struct Location {
+                uint64_t segment;
+                uint64_t offset;
+                size_t size;
+            };
+
+            std::string SegmentFileName(uint64_t number) const {
+                char buf[32];
+                std::snprintf(buf, sizeof(buf), "/%06llu%s", static_cast<unsigned long long>(number),
+                              kSegmentSuffix);
+                return path_ + buf;
+            }
+
+            // 结束正在写入的段并开始一个新的段，结束的段加入pending_等待写入磁盘。
+            // 在写入磁盘之前，该段的数据保存在sealing_中，仍然可以被读取
+            void SealActiveSegment() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 段写满时由插入数据的线程（通常是执行Get()或迭代器的用户线程）调用，
+            // 在后台线程中写入磁盘，使一次插入不需要等待整个段写入文件
+            void MaybeScheduleWrite() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            static void BGWork(void* cache);
+            // 依次将pending_中的段写入磁盘，写入文件时释放锁
+            void WritePendingSegments() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 将一个段写入磁盘，写入失败时丢弃该段
+            void WriteSegment(uint64_t number, const std::shared_ptr<std::string>& buffer,
+                              std::vector<std::string>* keys) LOCKS_EXCLUDED(mutex_);
+            // 删除最早的段文件及其在索引中的记录
+            void EvictOldestSegment() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+            // 从索引中删除segment中的key，索引中的key已经指向其他段时保留
+            void RemoveFromIndex(uint64_t segment, const std::vector<std::string>& keys)
+                EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+            Env* const env_;
+            const std::string path_;
+            const uint64_t capacity_;
+            const uint64_t segment_size_;
+
+            mutable port::Mutex mutex_;
+            // 后台写入完成时通知
+            port::CondVar bg_cv_;
+            std::unordered_map<std::string, Location> index_ GUARDED_BY(mutex_);
+            // 已经写入磁盘的段，按照编号（也即写入的先后顺序）排列
+            std::map<uint64_t, Segment> segments_ GUARDED_BY(mutex_);
+            // 正在写入的段，写满后整体写入磁盘，在此之前直接从内存中读取
+            uint64_t active_number_ GUARDED_BY(mutex_);
+            std::string active_buffer_ GUARDED_BY(mutex_);
+            std::vector<std::string> active_keys_ GUARDED_BY(mutex_);
+            // 已经写满、还未写入磁盘的段，用于读取
+            std::map<uint64_t, std::shared_ptr<std::string>> sealing_ GUARDED_BY(mutex_);
+            // 等待后台线程写入磁盘的段，按照编号排列
+            std::deque<PendingSegment> pending_ GUARDED_BY(mutex_);
+            // 所有段的总大小
+            uint64_t total_size_ GUARDED_BY(mutex_);
+            // 是否已经安排了后台写入
+            bool bg_scheduled_ GUARDED_BY(mutex_);
+        };
+
+        Status SegmentedPersistentCache::Recover() {
+            MutexLock l(&mutex_);
+            // 目录可能已经存在
+            env_->CreateDir(path_);
+            std::vector<std::string> children;
+            Status s = env_->GetChildren(path_, &children);
+            if(!s.ok()) {
+                return s;
+            }
+            std::vector<uint64_t> numbers;
+            for(const std::string& child : children) {
+                Slice name(child);
+                uint64_t number;
+                if(ConsumeDecimalNumber(&name, &number) && name == Slice(kSegmentSuffix)) {
+                    numbers.push_back(number);
+                }
+            }
+            std::sort(numbers.begin(), numbers.end());
+
+            for(uint64_t number : numbers) {
+                const std::string fname = SegmentFileName(number);
+                std::string contents;
+                Segment segment;
+                segment.size = 0;
+                if(ReadFileToString(env_, fname, &contents).ok()) {
+                    // 遇到损坏的记录时丢弃该段剩余的部分
+                    Slice input(contents);
+                    Slice key, data;
+                    size_t record_size;
+                    while(DecodeRecord(input, &key, &data, &record_size)) {
+                        index_[key.ToString()] = Location{number, segment.size, record_size};
+                        segment.keys.push_back(key.ToString());
+                        segment.size += record_size;
+                        input.remove_prefix(record_size);
+                    }
+                }
+                RandomAccessFile* file = nullptr;
+                if(segment.size == 0 || !env_->NewRandomAccessFile(fname, &file).ok()) {
+                    RemoveFromIndex(number, segment.keys);
+                    env_->RemoveFile(fname);
+                    continue;
+                }
+                segment.file.reset(file);
+                total_size_ += segment.size;
+                segments_[number] = std::move(segment);
+            }
+            if(!numbers.empty()) {
+                active_number_ = numbers.back() + 1;
+            }
+            while(total_size_ > capacity_ && !segments_.empty()) {
+                EvictOldestSegment();
+            }
+            return Status::OK();
+        }
+
+        Status SegmentedPersistentCache::Insert(const Slice& key, const Slice& data) {
+            MutexLock l(&mutex_);
+            if(sealing_.size() >= kMaxPendingSegments) {
+                // 后台写入跟不上，放弃这次插入
+                return Status::OK();
+            }
+            std::string k = key.ToString();
+            if(index_.find(k) != index_.end()) {
+                return Status::OK();
+            }
+            const uint64_t offset = active_buffer_.size();
+            EncodeRecord(key, data, &active_buffer_);
+            const size_t record_size = active_buffer_.size() - offset;
+            index_[k] = Location{active_number_, offset, record_size};
+            active_keys_.push_back(std::move(k));
+            total_size_ += record_size;
+
+            if(active_buffer_.size() >= segment_size_) {
+                SealActiveSegment();
+                MaybeScheduleWrite();
+            }
+            while(total_size_ > capacity_ && !segments_.empty()) {
+                EvictOldestSegment();
+            }
+            return Status::OK();
+        }
+
+        Status SegmentedPersistentCache::Lookup(const Slice& key, std::string* data) {
+            Location loc;
+            std::shared_ptr<RandomAccessFile> file;
+            std::string record;
+            {
+                MutexLock l(&mutex_);
+                auto iter = index_.find(key.ToString());
+                if(iter == index_.end()) {
+                    return Status::NotFound(Slice());
+                }
+                loc = iter->second;
+                auto sealing = sealing_.find(loc.segment);
+                if(loc.segment == active_number_) {
+                    record.assign(active_buffer_.data() + loc.offset, loc.size);
+                } else if(sealing != sealing_.end()) {
+                    record.assign(sealing->second->data() + loc.offset, loc.size);
+                } else {
+                    auto segment = segments_.find(loc.segment);
+                    if(segment == segments_.end()) {
+                        return Status::NotFound(Slice());
+                    }
+                    file = segment->second.file;
+                }
+            }
+
+            Slice input(record);
+            if(file != nullptr) {
+                // 读取磁盘时不持有锁
+                record.resize(loc.size);
+                Status s = file->Read(loc.offset, loc.size, &input, &record[0]);
+                if(!s.ok()) {
+                    return s;
+                }
+            }
+            Slice k, d;
+            size_t record_size;
+            if(!DecodeRecord(input, &k, &d, &record_size) || record_size != loc.size || k != key) {
+                MutexLock l(&mutex_);
+                auto iter = index_.find(key.ToString());
+                if(iter != index_.end() && iter->second.segment == loc.segment &&
+                   iter->second.offset == loc.offset) {
+                    index_.erase(iter);
+                }
+                return Status::Corruption("persistent cache record checksum mismatch");
+            }
+            data->assign(d.data(), d.size());
+            return Status::OK();
+        }
+
+        void SegmentedPersistentCache::SealActiveSegment() {
+            PendingSegment segment;
+            segment.number = active_number_;
+            segment.buffer = std::make_shared<std::string>();
+            segment.buffer->swap(active_buffer_);
+            segment.keys.swap(active_keys_);
+            sealing_[segment.number] = segment.buffer;
+            pending_.push_back(std::move(segment));
+            active_number_++;
+        }
+
+        void SegmentedPersistentCache::MaybeScheduleWrite() {
+            if(!bg_scheduled_) {
+                bg_scheduled_ = true;
+                env_->Schedule(&SegmentedPersistentCache::BGWork, this);
+            }
+        }
+
+        void SegmentedPersistentCache::BGWork(void* cache) {
+            SegmentedPersistentCache* c = reinterpret_cast<SegmentedPersistentCache*>(cache);
+            MutexLock l(&c->mutex_);
+            c->WritePendingSegments();
+            c->bg_scheduled_ = false;
+            c->bg_cv_.SignalAll();
+        }
+
+        void SegmentedPersistentCache::WritePendingSegments() {
+            while(!pending_.empty()) {
+                PendingSegment segment = std::move(pending_.front());
+                pending_.pop_front();
+                mutex_.Unlock();
+                WriteSegment(segment.number, segment.buffer, &segment.keys);
+                mutex_.Lock();
+            }
+        }
+
+        void SegmentedPersistentCache::WriteSegment(uint64_t number, const std::shared_ptr<std::string>& buffer,
+                                                      std::vector<std::string>* keys) {
+            const std::string fname = SegmentFileName(number);
+            Status s = WriteStringToFile(env_, *buffer, fname);
+            RandomAccessFile* file = nullptr;
+            if(s.ok()) {
+                s = env_->NewRandomAccessFile(fname, &file);
+            }
+
+            MutexLock l(&mutex_);
+            sealing_.erase(number);
+            if(s.ok()) {
+                Segment& segment = segments_[number];
+                segment.size = buffer->size();
+                segment.file.reset(file);
+                segment.keys.swap(*keys);
+            } else {
+                // 写入失败时丢弃该段，缓存仍然可用
+                RemoveFromIndex(number, *keys);
+                total_size_ -= buffer->size();
+                env_->RemoveFile(fname);
+            }
+            while(total_size_ > capacity_ && !segments_.empty()) {
+                EvictOldestSegment();
+            }
+        }
+
+        void SegmentedPersistentCache::EvictOldestSegment() {
+            auto iter = segments_.begin();
+            RemoveFromIndex(iter->first, iter->second.keys);
+            total_size_ -= iter->second.size;
+            env_->RemoveFile(SegmentFileName(iter->first));
+            segments_.erase(iter);
+        }
+
+        void SegmentedPersistentCache::RemoveFromIndex(uint64_t segment, const std::vector<std::string>& keys) {
+            for(const std::string& key : keys) {
+                auto iter = index_.find(key);
+                if(iter != index_.end() && iter->second.segment == segment) {
+                    index_.erase(iter);
+                }
+            }
+        }
+
+    } // end namespace
+
+    Status NewPersistentCache(Env* env, const std::string& path, uint64_t capacity, PersistentCache** result) {
+        *result = nullptr;
+        SegmentedPersistentCache* cache = new SegmentedPersistentCache(env, path, capacity);
+        Status s = cache->Recover();
+        if(s.ok()) {
+            *result = cache;
+        } else {
+            delete cache;
+        }
+        return s;
+    }
+
+} // end namespace leveldb
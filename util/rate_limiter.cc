@@ -0,0 +1,188 @@
+#include "util/rate_limiter.h"
+
+#include <algorithm>
+
+#include "leveldb/slice.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+    RateLimiter::~RateLimiter() {}
+
+    namespace {
+
+        // 自动调节时每经过多少个补充周期调整一次速率
+        static const int64_t kTunePeriods = 100;
+        // 额度被用尽的周期占比高于该值时提高速率，低于kTuneLowPercent时降低速率
+        static const int64_t kTuneHighPercent = 90;
+        static const int64_t kTuneLowPercent = 50;
+        // 每次调整的幅度
+        static const double kTuneFactor = 1.05;
+        // 自动调节时速率的下限为上限的1/kTuneRange
+        static const int64_t kTuneRange = 20;
+
+        class GenericRateLimiter : public RateLimiter {
+        public:
+            GenericRateLimiter(int64_t compaction_bytes_per_second, int64_t flush_bytes_per_second,
+                               int64_t refill_period_us, bool auto_tuned, Env* env)
+                : env_(env),
+                  refill_period_us_(std::max<int64_t>(refill_period_us, 1)),
+                  auto_tuned_(auto_tuned) {
+                SetBytesPerSecond(kCompaction, compaction_bytes_per_second);
+                SetBytesPerSecond(kFlush, flush_bytes_per_second);
+                for(int i = 0; i < kNumIOSources; i++) {
+                    buckets_[i].total_bytes = 0;
+                }
+            }
+
+            void Request(int64_t bytes, IOSource source) override {
+                MutexLock l(&mu_);
+                Bucket* b = &buckets_[source];
+                b->total_bytes += bytes;
+                while(bytes > 0 && b->rate > 0) {
+                    const uint64_t now = env_->NowMicros();
+                    if(now >= b->next_refill_micros) {
+                        Refill(b, now);
+                    }
+                    if(b->available > 0) {
+                        const int64_t granted = std::min(bytes, b->available);
+                        b->available -= granted;
+                        bytes -= granted;
+                        if(b->available == 0) {
+                            b->drained = true;
+                        }
+                        continue;
+                    }
+                    // 本周期的额度已经用完，等到下一次补充
+                    const uint64_t wait = b->next_refill_micros - now;
+                    mu_.Unlock();
+                    env_->SleepForMicroseconds(static_cast<int>(wait));
+                    mu_.Lock();
+                }
+            }
+
+            void SetBytesPerSecond(IOSource source, int64_t bytes_per_second) override {
+                MutexLock l(&mu_);
+                Bucket* b = &buckets_[source];
+                b->max_rate = std::max<int64_t>(bytes_per_second, 0);
+                b->rate = b->max_rate;
+                b->available = 0;
+                b->next_refill_micros = 0;
+                b->drained = false;
+                b->drained_periods = 0;
+                b->tune_start_micros = 0;
+            }
+
+            int64_t GetBytesPerSecond(IOSource source) const override {
+                MutexLock l(&mu_);
+                return buckets_[source].rate;
+            }
+
+            int64_t GetTotalBytesThrough(IOSource source) const override {
+                MutexLock l(&mu_);
+                return buckets_[source].total_bytes;
+            }
+
+        private:
+            // 每个IO来源独立的令牌桶
+            struct Bucket {
+                // 用户设置的速率，自动调节时为速率的上限
+                int64_t max_rate;
+                // 当前生效的速率
+                int64_t rate;
+                // 本周期剩余的额度
+                int64_t available;
+                // 下一次补充额度的时间
+                uint64_t next_refill_micros;
+                // 本周期的额度是否被用尽过
+                bool drained;
+                // 自上次调整速率以来额度被用尽的周期数
+                int64_t drained_periods;
+                // 上次调整速率的时间
+                uint64_t tune_start_micros;
+                // 累计申请过的字节数
+                int64_t total_bytes;
+            };
+
+            // 开始一个新的周期，补充一个周期的额度，未用完的额度不会累积到下一个周期
+            void Refill(Bucket* b, uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                if(b->drained) {
+                    b->drained_periods++;
+                    b->drained = false;
+                }
+                if(auto_tuned_) {
+                    Tune(b, now);
+                }
+                b->available = std::max<int64_t>(b->rate * refill_period_us_ / 1000000, 1);
+                b->next_refill_micros = now + refill_period_us_;
+            }
+
+            // 根据额度被用尽的频繁程度调整速率
+            void Tune(Bucket* b, uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                if(b->tune_start_micros == 0) {
+                    b->tune_start_micros = now;
+                    return;
+                }
+                const int64_t elapsed_periods =
+                        static_cast<int64_t>(now - b->tune_start_micros) / refill_period_us_;
+                if(elapsed_periods < kTunePeriods) {
+                    return;
+                }
+                const int64_t drained_percent = b->drained_periods * 100 / elapsed_periods;
+                const int64_t min_rate = std::max<int64_t>(b->max_rate / kTuneRange, 1);
+                if(drained_percent > kTuneHighPercent) {
+                    b->rate = std::min(b->max_rate, static_cast<int64_t>(b->rate * kTuneFactor) + 1);
+                } else if(drained_percent < kTuneLowPercent) {
+                    b->rate = std::max(min_rate, static_cast<int64_t>(b->rate / kTuneFactor));
+                }
+                b->drained_periods = 0;
+                b->tune_start_micros = now;
+            }
+
+            Env* const env_;
+            const int64_t refill_period_us_;
+            const bool auto_tuned_;
+            mutable port::Mutex mu_;
+            Bucket buckets_[kNumIOSources] GUARDED_BY(mu_);
+        };
+
+        class RateLimitedWritableFile : public WritableFile {
+        public:
+            RateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                                    RateLimiter::IOSource source)
+                : base_(base), limiter_(limiter), source_(source) {}
+
+            ~RateLimitedWritableFile() override { delete base_; }
+
+            Status Append(const Slice& data) override {
+                limiter_->Request(static_cast<int64_t>(data.size()), source_);
+                return base_->Append(data);
+            }
+            Status Close() override { return base_->Close(); }
+            Status Flush() override { return base_->Flush(); }
+            Status Sync() override { return base_->Sync(); }
+
+        private:
+            WritableFile* const base_;
+            RateLimiter* const limiter_;
+            const RateLimiter::IOSource source_;
+        };
+
+    } // end namespace
+
+    RateLimiter* NewGenericRateLimiter(int64_t compaction_bytes_per_second,
+                                       int64_t flush_bytes_per_second,
+                                       int64_t refill_period_us, bool auto_tuned, Env* env) {
+        return new GenericRateLimiter(compaction_bytes_per_second, flush_bytes_per_second,
+                                      refill_period_us, auto_tuned,
+                                      env != nullptr ? env : Env::Default());
+    }
+
+    WritableFile* NewRateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                                             RateLimiter::IOSource source) {
+        return new RateLimitedWritableFile(base, limiter, source);
+    }
+
+} // end namespace leveldb
@@ -0,0 +1,16 @@
+#ifndef LLEVELDB_RATE_LIMITER_H
+#define LLEVELDB_RATE_LIMITER_H
+
+#include "leveldb/env.h"
+#include "leveldb/rate_limiter.h"
+
+namespace leveldb {
+
+    // 返回一个包装了base的WritableFile，每次Append前先向limiter申请相应的额度。
+    // 返回的对象拥有base的所有权，limiter必须比返回的对象存活更久。
+    WritableFile* NewRateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                                             RateLimiter::IOSource source);
+
+} // end namespace leveldb
+
+#endif //LLEVELDB_RATE_LIMITER_H
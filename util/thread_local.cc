@@ -0,0 +1,171 @@
+#include "util/thread_local.h"
+
+#include <atomic>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+    namespace {
+
+        // 一个线程中某个ThreadLocalPtr的槽位
+        struct Entry {
+            Entry() : ptr(nullptr) {}
+            // std::vector扩容时需要拷贝，扩容只会在持有StaticMeta::mu_时由所属线程进行
+            Entry(const Entry& e) : ptr(e.ptr.load(std::memory_order_relaxed)) {}
+
+            std::atomic<void*> ptr;
+        };
+
+        // 一个线程的所有槽位，下标为ThreadLocalPtr的id，所有线程的ThreadData组成一个双向链表
+        struct ThreadData {
+            std::vector<Entry> entries;
+            ThreadData* next;
+            ThreadData* prev;
+        };
+
+        // 管理所有线程的ThreadData以及各个ThreadLocalPtr的id
+        class StaticMeta {
+        public:
+            StaticMeta() : next_id_(0) {
+                head_.next = &head_;
+                head_.prev = &head_;
+            }
+
+            // 为一个新的ThreadLocalPtr分配id，优先复用已释放的id
+            uint32_t AcquireId(ThreadLocalPtr::UnrefHandler handler) {
+                MutexLock l(&mu_);
+                uint32_t id;
+                if(!free_ids_.empty()) {
+                    id = free_ids_.back();
+                    free_ids_.pop_back();
+                } else {
+                    id = next_id_++;
+                    handlers_.resize(next_id_);
+                }
+                handlers_[id] = handler;
+                return id;
+            }
+
+            // 释放id，并清空所有线程中该id的槽位
+            void ReleaseId(uint32_t id) {
+                MutexLock l(&mu_);
+                for(ThreadData* t = head_.next; t != &head_; t = t->next) {
+                    if(id < t->entries.size()) {
+                        void* ptr = t->entries[id].ptr.exchange(nullptr);
+                        if(ptr != nullptr && handlers_[id] != nullptr) {
+                            handlers_[id](ptr);
+                        }
+                    }
+                }
+                handlers_[id] = nullptr;
+                free_ids_.push_back(id);
+            }
+
+            // 返回当前线程中id对应的槽位
+            std::atomic<void*>* GetEntry(uint32_t id);
+
+            void Scrape(uint32_t id, std::vector<void*>* ptrs, void* replacement) {
+                MutexLock l(&mu_);
+                for(ThreadData* t = head_.next; t != &head_; t = t->next) {
+                    if(id < t->entries.size()) {
+                        void* ptr = t->entries[id].ptr.exchange(replacement);
+                        if(ptr != nullptr) {
+                            ptrs->push_back(ptr);
+                        }
+                    }
+                }
+            }
+
+            // 线程退出时调用，对该线程中剩余的非空指针调用各自的回调
+            void OnThreadExit(ThreadData* t) {
+                MutexLock l(&mu_);
+                t->next->prev = t->prev;
+                t->prev->next = t->next;
+                for(uint32_t id = 0; id < t->entries.size(); id++) {
+                    void* ptr = t->entries[id].ptr.load(std::memory_order_relaxed);
+                    if(ptr != nullptr && handlers_[id] != nullptr) {
+                        handlers_[id](ptr);
+                    }
+                }
+                delete t;
+            }
+
+        private:
+            port::Mutex mu_;
+            ThreadData head_ GUARDED_BY(mu_);
+            uint32_t next_id_ GUARDED_BY(mu_);
+            std::vector<uint32_t> free_ids_ GUARDED_BY(mu_);
+            std::vector<ThreadLocalPtr::UnrefHandler> handlers_ GUARDED_BY(mu_);
+        };
+
+        // 有意不释放，避免进程退出时其他线程仍在使用
+        StaticMeta* Meta() {
+            static StaticMeta* meta = new StaticMeta;
+            return meta;
+        }
+
+        // 线程退出时通过其析构函数清理该线程的ThreadData
+        struct ThreadDataHolder {
+            ThreadData* data = nullptr;
+            ~ThreadDataHolder() {
+                if(data != nullptr) {
+                    Meta()->OnThreadExit(data);
+                }
+            }
+        };
+
+        thread_local ThreadDataHolder tls_holder;
+
+        std::atomic<void*>* StaticMeta::GetEntry(uint32_t id) {
+            ThreadData* t = tls_holder.data;
+            if(t == nullptr) {
+                t = new ThreadData;
+                MutexLock l(&mu_);
+                t->next = &head_;
+                t->prev = head_.prev;
+                head_.prev->next = t;
+                head_.prev = t;
+                tls_holder.data = t;
+            }
+            if(id >= t->entries.size()) {
+                // 扩容会移动槽位，Scrape()等会在持有mu_时访问其他线程的槽位，因此需要加锁
+                MutexLock l(&mu_);
+                t->entries.resize(id + 1);
+            }
+            return &t->entries[id].ptr;
+        }
+
+    } // end namespace
+
+    ThreadLocalPtr::ThreadLocalPtr(UnrefHandler handler)
+        : id_(Meta()->AcquireId(handler)) {}
+
+    ThreadLocalPtr::~ThreadLocalPtr() {
+        Meta()->ReleaseId(id_);
+    }
+
+    void* ThreadLocalPtr::Get() const {
+        return Meta()->GetEntry(id_)->load(std::memory_order_acquire);
+    }
+
+    void ThreadLocalPtr::Reset(void* ptr) {
+        Meta()->GetEntry(id_)->store(ptr, std::memory_order_release);
+    }
+
+    void* ThreadLocalPtr::Swap(void* ptr) {
+        return Meta()->GetEntry(id_)->exchange(ptr, std::memory_order_acquire);
+    }
+
+    bool ThreadLocalPtr::CompareAndSwap(void* ptr, void*& expected) {
+        return Meta()->GetEntry(id_)->compare_exchange_strong(expected, ptr, std::memory_order_release,
+                                                              std::memory_order_relaxed);
+    }
+
+    void ThreadLocalPtr::Scrape(std::vector<void*>* ptrs, void* replacement) {
+        Meta()->Scrape(id_, ptrs, replacement);
+    }
+
+} // end namespace leveldb
@@ -0,0 +1,46 @@
+#ifndef LLEVELDB_THREAD_LOCAL_H
+#define LLEVELDB_THREAD_LOCAL_H
+
+#include <cstdint>
+#include <vector>
+
+namespace leveldb {
+
+    // 线程局部的指针。与C++的thread_local变量不同，ThreadLocalPtr可以作为类的非静态成员，
+    // 每个ThreadLocalPtr对象在每个线程中都有一个独立的槽位，各线程只读写自己的槽位，不需要加锁。
+    // 其他线程可以通过Scrape()一次性替换所有线程中的槽位，用于使各线程缓存的数据失效。
+    class ThreadLocalPtr {
+    public:
+        // 线程退出或ThreadLocalPtr析构时，对槽位中剩余的非空指针调用的回调
+        typedef void (*UnrefHandler)(void* ptr);
+
+        explicit ThreadLocalPtr(UnrefHandler handler = nullptr);
+
+        ThreadLocalPtr(const ThreadLocalPtr&) = delete;
+        ThreadLocalPtr& operator=(const ThreadLocalPtr&) = delete;
+
+        ~ThreadLocalPtr();
+
+        // 返回当前线程槽位中的指针
+        void* Get() const;
+
+        // 设置当前线程槽位中的指针
+        void Reset(void* ptr);
+
+        // 将当前线程槽位中的指针替换为ptr，返回原来的指针
+        void* Swap(void* ptr);
+
+        // 若当前线程槽位中的指针等于expected，则将其替换为ptr并返回true；
+        // 否则将expected设置为槽位中的指针并返回false
+        bool CompareAndSwap(void* ptr, void*& expected);
+
+        // 将所有线程槽位中的指针替换为replacement，并将原来的非空指针保存到ptrs
+        void Scrape(std::vector<void*>* ptrs, void* replacement);
+
+    private:
+        const uint32_t id_;
+    };
+
+} // end namespace leveldb
+
+#endif //LLEVELDB_THREAD_LOCAL_H
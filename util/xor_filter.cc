@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+// XOR filter（binary fuse变体，见[Graf, Lemire 2022]）的格式：
+//      [fingerprint 0]...[fingerprint array_length-1][seed: fixed64][segment_count: fixed32][segment_length_log: 1 byte]
+// 其中 array_length = (segment_count + 2) << segment_length_log。
+//
+// 每个key映射到相邻3个segment中的各一个位置h0、h1、h2，构造时保证
+// F[h0] ^ F[h1] ^ F[h2] 等于该key的8位fingerprint，查询时比较二者是否相等即可，误报率约为1/256。
+// 每个key约占用9 bit（数组约为key数量的1.125倍），而Bloom filter达到相同的误报率需要约12 bit。
+// 构造需要对超图进行peeling，比Bloom filter慢，但filter在SSTable中是不可变的，只需构造一次。
+
+namespace leveldb {
+    namespace {
+        // seed之后的尾部长度
+        static const size_t kTrailerSize = 8 + 4 + 1;
+        // segment长度的上限，也即 1 << 18
+        static const int kMaxSegmentLengthLog = 18;
+
+        // 计算64位哈希值，由两个不同seed的32位哈希值拼接而成
+        static uint64_t XorFilterHash(const Slice& key) {
+            return (static_cast<uint64_t>(Hash(key.data(), key.size(), 0xbc9f1d34)) << 32) |
+                   Hash(key.data(), key.size(), 0x2f1d7a3b);
+        }
+
+        // murmur3的finalizer，用于结合seed打散哈希值，构造失败时更换seed即可得到新的映射
+        static inline uint64_t Mix(uint64_t h, uint64_t seed) {
+            h += seed;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        static inline uint8_t Fingerprint(uint64_t h) {
+            return static_cast<uint8_t>(h ^ (h >> 32));
+        }
+
+        // filter的布局参数
+        struct Layout {
+            uint32_t segment_length_log;
+            uint32_t segment_count;
+
+            uint32_t segment_length() const { return 1u << segment_length_log; }
+            uint32_t array_length() const { return (segment_count + 2) << segment_length_log; }
+
+            // 计算哈希值h在数组中对应的3个位置，分别位于相邻的3个segment中
+            void Positions(uint64_t h, uint32_t pos[3]) const {
+                const uint32_t length = segment_length();
+                const uint32_t mask = length - 1;
+                const uint64_t range = static_cast<uint64_t>(segment_count) << segment_length_log;
+                pos[0] = static_cast<uint32_t>(((h >> 32) * range) >> 32);
+                pos[1] = (pos[0] + length) ^ (static_cast<uint32_t>(h >> 18) & mask);
+                pos[2] = (pos[0] + 2 * length) ^ (static_cast<uint32_t>(h) & mask);
+            }
+        };
+
+        // 根据key的数量n计算布局，key越少数组相对越大，以保证构造能够成功
+        static Layout ComputeLayout(size_t n) {
+            Layout layout;
+            int log = (n == 0) ? 2 : static_cast<int>(std::floor(std::log(static_cast<double>(n)) / std::log(3.33) + 2.25));
+            if(log < 2) log = 2;
+            if(log > kMaxSegmentLengthLog) log = kMaxSegmentLengthLog;
+            layout.segment_length_log = static_cast<uint32_t>(log);
+
+            double size_factor = 1.125;
+            if(n > 1) {
+                size_factor = std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(static_cast<double>(n)));
+            }
+            const uint64_t capacity = (n > 1) ? static_cast<uint64_t>(std::llround(n * size_factor)) : 0;
+            const uint64_t length = layout.segment_length();
+            int64_t segment_count = static_cast<int64_t>((capacity + length - 1) / length) - 2;
+            if(segment_count < 1) segment_count = 1;
+            layout.segment_count = static_cast<uint32_t>(segment_count);
+            return layout;
+        }
+
+        // 构造过程中数组每个位置的状态：映射到该位置且尚未被peel的key的数量、这些key哈希值的异或、
+        // 以及该位置在这些key的3个位置中的下标的异或。只剩一个key时，后两者即为该key的哈希值及下标
+        struct Cell {
+            uint64_t hash_xor;
+            uint32_t count;
+            uint8_t index_xor;
+        };
+
+        // 尝试使用layout与seed为hashes构造fingerprint数组，超图无法完全peel时返回false
+        static bool TryBuild(const std::vector<uint64_t>& hashes, const Layout& layout, uint64_t seed,
+                             std::vector<uint8_t>* fingerprints) {
+            const uint32_t array_length = layout.array_length();
+            std::vector<Cell> cells(array_length, Cell{0, 0, 0});
+            uint32_t pos[3];
+            for(uint64_t key_hash : hashes) {
+                const uint64_t h = Mix(key_hash, seed);
+                layout.Positions(h, pos);
+                for(uint8_t j = 0; j < 3; j++) {
+                    Cell& c = cells[pos[j]];
+                    c.hash_xor ^= h;
+                    c.count++;
+                    c.index_xor ^= j;
+                }
+            }
+
+            // 不断取出只被一个key映射到的位置，将该key从超图中移除，移除的顺序保存在stack中
+            std::vector<uint32_t> queue;
+            for(uint32_t i = 0; i < array_length; i++) {
+                if(cells[i].count == 1) {
+                    queue.push_back(i);
+                }
+            }
+            std::vector<std::pair<uint64_t, uint8_t>> stack;
+            stack.reserve(hashes.size());
+            while(!queue.empty()) {
+                const uint32_t i = queue.back();
+                queue.pop_back();
+                if(cells[i].count != 1) {
+                    continue;
+                }
+                const uint64_t h = cells[i].hash_xor;
+                const uint8_t found = cells[i].index_xor;
+                stack.emplace_back(h, found);
+                layout.Positions(h, pos);
+                for(uint8_t j = 0; j < 3; j++) {
+                    Cell& c = cells[pos[j]];
+                    c.hash_xor ^= h;
+                    c.count--;
+                    c.index_xor ^= j;
+                    if(j != found && c.count == 1) {
+                        queue.push_back(pos[j]);
+                    }
+                }
+            }
+            if(stack.size() != hashes.size()) {
+                return false;
+            }
+
+            // 逆序为每个key赋值：key被移除时其found位置不会再被之后移除的key使用，
+            // 因此逆序处理时可以通过该位置使等式成立而不影响已处理的key
+            fingerprints->assign(array_length, 0);
+            uint8_t* f = fingerprints->data();
+            for(auto it = stack.rbegin(); it != stack.rend(); ++it) {
+                const uint64_t h = it->first;
+                const uint8_t found = it->second;
+                layout.Positions(h, pos);
+                f[pos[found]] = Fingerprint(h) ^ f[pos[(found + 1) % 3]] ^ f[pos[(found + 2) % 3]];
+            }
+            return true;
+        }
+
+        class XorFilterPolicy : public FilterPolicy {
+            public:
+            const char* Name() const override { return "leveldb.BinaryFuseFilter8"; }
+
+            void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+                // 同一个user key的多个版本会产生相同的哈希值，相同的哈希值无法peel，因此先去重
+                std::vector<uint64_t> hashes(n);
+                for(int i = 0; i < n; i++) {
+                    hashes[i] = XorFilterHash(keys[i]);
+                }
+                std::sort(hashes.begin(), hashes.end());
+                hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+                if(hashes.empty()) {
+                    // 空的filter不匹配任何key
+                    return;
+                }
+
+                Layout layout = ComputeLayout(hashes.size());
+                std::vector<uint8_t> fingerprints;
+                uint64_t seed = 0;
+                for(int attempt = 1; ; attempt++) {
+                    seed = Mix(attempt, 0x726a5f3e9b2c4d11ULL);
+                    if(TryBuild(hashes, layout, seed, &fingerprints)) {
+                        break;
+                    }
+                    // 构造失败的概率很低，多次失败时扩大数组以保证最终能够成功
+                    if(attempt % 8 == 0) {
+                        layout.segment_count++;
+                    }
+                }
+
+                dst->append(reinterpret_cast<const char*>(fingerprints.data()), fingerprints.size());
+                PutFixed64(dst, seed);
+                PutFixed32(dst, layout.segment_count);
+                dst->push_back(static_cast<char>(layout.segment_length_log));
+            }
+
+            bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+                const size_t len = filter.size();
+                if(len < kTrailerSize) {
+                    // 空的filter不匹配任何key
+                    return false;
+                }
+                const char* trailer = filter.data() + len - kTrailerSize;
+                Layout layout;
+                const uint64_t seed = DecodeFixed64(trailer);
+                layout.segment_count = DecodeFixed32(trailer + 8);
+                layout.segment_length_log = static_cast<unsigned char>(trailer[12]);
+                if(layout.segment_length_log > kMaxSegmentLengthLog || layout.segment_count < 1 ||
+                   static_cast<uint64_t>(layout.segment_count) + 2 > ((len - kTrailerSize) >> layout.segment_length_log) ||
+                   layout.array_length() != len - kTrailerSize) {
+                    // 保留给可能的新编码，视为匹配
+                    return true;
+                }
+
+                const uint64_t h = Mix(XorFilterHash(key), seed);
+                uint32_t pos[3];
+                layout.Positions(h, pos);
+                const uint8_t* f = reinterpret_cast<const uint8_t*>(filter.data());
+                return Fingerprint(h) == (f[pos[0]] ^ f[pos[1]] ^ f[pos[2]]);
+            }
+        };
+    } // end anonymous namespace
+
+    const FilterPolicy* NewXorFilterPolicy() {
+        return new XorFilterPolicy();
+    }
+} // end namespace leveldb